@@ -0,0 +1,110 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Userspace interface of /dev/gfshare.
+ *
+ * Each open file gets its own rings and data area. GFSHARE_IOC_SETUP sizes
+ * them, after which the whole region is mmap'd at offset 0:
+ *
+ *   [struct gfshare_dev_rings][sq_entries sqes][cq_entries cqes][data]
+ *
+ * at the offsets SETUP returns. Descriptors name their secret, share
+ * numbers and shares by offset into the data area, which the kernel reads
+ * and writes in place. The client writes sqes, bumps sq_tail (release),
+ * and rings the doorbell with GFSHARE_IOC_ENTER once per batch; the kernel
+ * bumps sq_head as it consumes them. Completions appear between cq_head and
+ * cq_tail (acquire); the client advances cq_head. poll() reports POLLIN
+ * while completions are waiting.
+ *
+ * An sqe whose shares add up to more than GFSHARE_DEV_MAX_SQE_BYTES
+ * (sharecount * size) completes with -E2BIG; longer secrets are split into
+ * several sqes by the client.
+ */
+
+#ifndef GFSHARE_DEV_H
+#define GFSHARE_DEV_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+#define GFSHARE_DEV_MAX_ENTRIES 4096
+#define GFSHARE_DEV_MAX_DATA (256u << 20)
+#define GFSHARE_DEV_MAX_SQE_BYTES (2u << 20)
+
+struct gfshare_dev_params {
+    __u32 sq_entries;       /* in, rounded up to a power of two */
+    __u32 cq_entries;       /* in, 0 for twice sq_entries */
+    __u64 data_size;        /* in */
+    __u64 sq_off;           /* out: offsets into the mapping */
+    __u64 cq_off;
+    __u64 data_off;
+    __u64 map_size;         /* out: length to mmap */
+};
+
+struct gfshare_dev_rings {
+    __u32 sq_head;          /* written by the kernel */
+    __u32 sq_tail;          /* written by the client */
+    __u32 sq_mask;
+    __u32 cq_head;          /* written by the client */
+    __u32 cq_tail;          /* written by the kernel */
+    __u32 cq_mask;
+    __u32 cq_overflow;      /* completions dropped on a full queue */
+    __u32 resv;
+};
+
+enum {
+    GFSHARE_OP_SPLIT,       /* secret -> sharecount shares */
+    GFSHARE_OP_COMBINE,     /* shares present in sharenrs -> secret */
+};
+
+struct gfshare_sqe {
+    __u8 op;
+    __u8 threshold;
+    __u16 sharecount;       /* 1..255 */
+    __u32 size;             /* secret bytes; every share is as long */
+    __u64 user_data;        /* echoed in the completion */
+    __u64 sharenrs_off;     /* sharecount x values, 0 for absent (combine) */
+    __u64 secret_off;
+    __u64 shares_off;       /* share i at shares_off + i * share_stride */
+    __u64 share_stride;
+};
+
+struct gfshare_cqe {
+    __u64 user_data;
+    __s32 res;              /* 0 or a negative errno */
+    __u32 flags;
+};
+
+struct gfshare_dev_enter {
+    __u32 to_submit;        /* sqes to consume at most */
+    __u32 min_complete;     /* then wait for this many completions */
+};
+
+#define GFSHARE_IOC_MAGIC 'G'
+#define GFSHARE_IOC_SETUP _IOWR(GFSHARE_IOC_MAGIC, 0x40, struct gfshare_dev_params)
+/* Returns the number of sqes consumed */
+#define GFSHARE_IOC_ENTER _IOW(GFSHARE_IOC_MAGIC, 0x41, struct gfshare_dev_enter)
+
+#endif /* GFSHARE_DEV_H */
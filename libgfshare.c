@@ -25,111 +25,114 @@
 
 //#include "config.h"
 #include "libgfshare.h"
+#include "libgfshare_internal.h"
 #include "libgfshare_tables.h"
 
+#include <linux/kernel.h>
 #include <linux/slab.h>
 #include <linux/random.h>
 #include <linux/string.h>
-#include <linux/timekeeping.h>
 
 
-struct _gfshare_ctx {
-  uint32_t sharecount;
-  uint32_t threshold;
-  uint32_t maxsize;
-  uint32_t size;
-  uint8_t* sharenrs;
-  uint8_t* buffer;
-  uint32_t buffersize;
-};
-
 //TODO see if there are any faster methods to get good random numbers, RDRAND if x86?
 static void _gfshare_fill_rand_using_random_bytes(uint8_t* buffer, size_t count){
     get_random_bytes(buffer, count);
 }
 
-#define BLOCK_SIZE 16
-
-#define ROR(x, r) ((x >> r) | (x << (64 - r)))
-#define ROL(x, r) ((x << r) | (x >> (64 - r)))
-#define R(x, y, k) (x = ROR(x, 8), x += y, x ^= k, y = ROL(y, 3), y ^= x)
-#define ROUNDS 32
-
-/**
- * pt: plaintext
- * ct: ciphertext
- * k: key
- * we assume that input arrays are of length 2 so we get 128 bits
- * Should generate the key on the fly, just for simplicity sake
- * Better performance can be had by computing round keys once.
- * This function is obtained from the following paper, https://eprint.iacr.org/2013/404
- */
-void speck_encrypt(uint64_t ct[2], uint64_t const pt[2], uint64_t const K[2])
-{
-    uint64_t y = pt[0], x = pt[1], b = K[0], a = K[1];
-    int i = 0;
-    R(x, y, b);
-    for (i = 0; i < ROUNDS - 1; i++) {
-        R(a, b, i);
-        R(x, y, b);
-    }
-
-    ct[0] = y;
-    ct[1] = x;
-}
-
-/**
- * output_length: size of the output block
- * output_block: destination for pseudorandom bits
- * seed: a 128 bit random number
- * Generate a block of random bytes given a key (seed) by running speck in counter mode
- * block input should be aligned to 128 bit (16 byte)  boundaries
- * We assume a length of 16 bytes (128 bits) for the seed.
+/* Take what we can from this CPU's pre-generated pool and only run the
+ * random backend inline for whatever is left.
  */
-void generate_block_ctr(size_t output_length, uint8_t *output_block, uint8_t *seed){
-    uint32_t rounds = output_length/BLOCK_SIZE;
-    uint64_t i, ctr[2], key[2], output[2];
-    uint64_t j = 0;
+static void _gfshare_fill_rand_default(uint8_t* buffer, size_t count){
+    size_t done = gfshare_rand_pool_take(buffer, count);
 
-    if(output_length % BLOCK_SIZE != 0){
-        printk(KERN_INFO "Not aligned to 128 bit boundary %ld", output_length);
+    if(done < count){
+        gfshare_rand->generate(gfshare_rand, buffer + done, count - done);
     }
+}
 
-    key[0] = ((uint64_t *)seed)[0];
-    key[1] = ((uint64_t *)seed)[1];
+gfshare_rand_func_t gfshare_fill_rand = _gfshare_fill_rand_default;
 
-    ctr[0] = 0;
-    ctr[1] = 0;
+/* -----------------------------------------------------------[ Module ]---- */
 
-    for(i = 0; i < rounds; i++){
-       speck_encrypt(output, ctr, key);
-       ((uint64_t *)output_block)[j + 1] = output[1];
-       ((uint64_t *)output_block)[j + 0] = output[0];
-       ctr[0]++;
-       j += 2;
-    }
-}
+/* Pick the arithmetic and PRNG engines for this CPU, fill the random
+ * pools and set up the debugfs statistics. Call once before anything else.
+ */
+int gfshare_init(void)
+{
+  int err;
+
+  gfshare_gf_init();
+  gfshare_spec_init();
+  gfshare16_init();
+  gfshare_speck_init();
+  err = gfshare_rand_init();
+  if(err)
+    return err;
+  err = gfshare_rand_pool_init();
+  if(err)
+    goto fail_pool;
+  err = _gfshare_par_init();
+  if(err)
+    goto fail_par;
+  err = gfshare_ctx_pool_init();
+  if(err)
+    goto fail_ctx_pool;
+  err = gfshare_async_init();
+  if(err)
+    goto fail_async;
+  gfshare_stats_init();
+  return 0;
 
-uint64_t * get_seed_64(void){
-    static uint64_t random[2];
-    get_random_bytes(random, 16);
-    return random;
+fail_async:
+  gfshare_ctx_pool_exit();
+fail_ctx_pool:
+  _gfshare_par_exit();
+fail_par:
+  gfshare_rand_pool_exit();
+fail_pool:
+  gfshare_rand_exit();
+  return err;
 }
 
-static void _gfshare_fill_rand_using_speck(uint8_t* buffer, size_t count){
-    uint8_t *key = (uint8_t*)get_seed_64();
-    generate_block_ctr(count, buffer, key);
+/* Stop the background refill and wipe the random pools */
+void gfshare_exit(void)
+{
+  gfshare_stats_exit();
+  gfshare_async_exit();
+  gfshare_ctx_pool_exit();
+  _gfshare_par_exit();
+  gfshare_rand_pool_exit();
+  gfshare_rand_exit();
 }
 
-gfshare_rand_func_t gfshare_fill_rand = _gfshare_fill_rand_using_speck;
-
-
 /* ------------------------------------------------------[ Preparation ]---- */
 
+/* Switch the context to engine 'gf' and pick the specialised kernels for
+ * its shape, if there are any for that engine
+ */
+static void _gfshare_ctx_use_gf(gfshare_ctx* ctx, const struct gfshare_gf_ops* gf)
+{
+  uint32_t i;
+
+  ctx->gf = gf;
+  ctx->enc_kernel = NULL;
+  ctx->dec_kernel = NULL;
+  if( gf == gfshare_gf ) {
+    ctx->enc_kernel = gfshare_spec_find_enc( ctx->threshold, ctx->sharecount );
+    ctx->dec_kernel = gfshare_spec_find_dec( ctx->threshold );
+  }
+  if( ctx->enc_kernel ) {
+    for( i = 0; i < ctx->sharecount; i++ )
+      gfshare_gf_nibbles( ctx->sharenrs[i], ctx->enc_tbl[i] );
+  }
+}
+
+/* 'buffersize' bytes of working buffer are allocated; 0 for none */
 static gfshare_ctx * _gfshare_ctx_init_core(const uint8_t *sharenrs, 
 		                            uint32_t sharecount, 
 					    uint32_t threshold, 
-					    size_t maxsize ) 
+					    size_t maxsize,
+					    size_t buffersize ) 
 {
   gfshare_ctx *ctx;
 
@@ -146,6 +149,8 @@ static gfshare_ctx * _gfshare_ctx_init_core(const uint8_t *sharenrs,
   ctx->threshold = threshold;
   ctx->maxsize = maxsize;
   ctx->size = maxsize;
+  ctx->chunks = 1;
+  ctx->hybrid = 0;
   ctx->sharenrs = kmalloc( sharecount, GFP_KERNEL);
   
   if( ctx->sharenrs == NULL ) {
@@ -154,14 +159,26 @@ static gfshare_ctx * _gfshare_ctx_init_core(const uint8_t *sharenrs,
   }
   
   memcpy( ctx->sharenrs, sharenrs, sharecount );
-  ctx->buffer = kmalloc( sharecount * maxsize, GFP_KERNEL);
+  ctx->plans = NULL;
+  ctx->plan = NULL;
+  ctx->plan_clock = 0;
+  ctx->rand = NULL;
+  ctx->parallel = 0;
+  ctx->borrowed = NULL;
+  ctx->stream = NULL;
+  ctx->pool = NULL;
+  ctx->buffersize = buffersize;
+  ctx->buffer = NULL;
+  if( buffersize )
+    ctx->buffer = kmalloc( buffersize, GFP_KERNEL);
   
-  if( ctx->buffer == NULL ) {
+  if( buffersize && ctx->buffer == NULL ) {
     kfree( ctx->sharenrs );
     kfree( ctx );
     return NULL;
   }
   
+  _gfshare_ctx_use_gf( ctx, gfshare_gf );
   return ctx;
 }
 
@@ -182,7 +199,48 @@ gfshare_ctx * gfshare_ctx_init_enc(const uint8_t* sharenrs,
     }
   }
 
-  return _gfshare_ctx_init_core( sharenrs, sharecount, threshold, maxsize );
+  return _gfshare_ctx_init_core( sharenrs, sharecount, threshold, maxsize,
+                                 sharecount * maxsize );
+}
+
+/* Carve GFSHARE_PLAN_CACHE empty decode plans out of one allocation */
+static size_t _gfshare_dec_plans_size(uint32_t sharecount, uint32_t threshold)
+{
+  size_t each = ALIGN(threshold * (256 + 32 + sizeof(uint32_t)) + sharecount, 8);
+
+  return GFSHARE_PLAN_CACHE * (sizeof(struct gfshare_dec_plan) + each);
+}
+
+/* Point each plan at its slice of the zeroed storage that follows them */
+static void _gfshare_dec_plans_carve(gfshare_ctx* ctx, void* plans)
+{
+  size_t rows = ctx->threshold * 256;
+  size_t nibbles = ctx->threshold * 32;
+  size_t index = ctx->threshold * sizeof(uint32_t);
+  size_t each = ALIGN(rows + nibbles + index + ctx->sharecount, 8);
+  uint8_t* storage;
+  int n;
+
+  ctx->plans = plans;
+  storage = (uint8_t*)(ctx->plans + GFSHARE_PLAN_CACHE);
+  for(n = 0; n < GFSHARE_PLAN_CACHE; n++) {
+    ctx->plans[n].rows = (uint8_t (*)[256])storage;
+    ctx->plans[n].nibbles = (uint8_t (*)[32])(storage + rows);
+    ctx->plans[n].index = (uint32_t*)(storage + rows + nibbles);
+    ctx->plans[n].sharenrs = storage + rows + nibbles + index;
+    storage += each;
+  }
+}
+
+static int _gfshare_dec_plans_alloc(gfshare_ctx* ctx)
+{
+  void* plans = kzalloc( _gfshare_dec_plans_size( ctx->sharecount, ctx->threshold ),
+                         GFP_KERNEL);
+
+  if( plans == NULL )
+    return 1;
+  _gfshare_dec_plans_carve( ctx, plans );
+  return 0;
 }
 
 /* Initialise a gfshare context for recombining shares */
@@ -191,7 +249,122 @@ gfshare_ctx* gfshare_ctx_init_dec(const uint8_t* sharenrs,
                                   uint32_t threshold,
                                   size_t maxsize)
 {
-  return _gfshare_ctx_init_core( sharenrs, sharecount, threshold, maxsize );
+  gfshare_ctx *ctx;
+
+  ctx = _gfshare_ctx_init_core( sharenrs, sharecount, threshold, maxsize,
+                                sharecount * maxsize );
+  if( ctx == NULL )
+    return NULL;
+
+  if( _gfshare_dec_plans_alloc( ctx ) ) {
+    kfree( ctx->sharenrs );
+    kfree( ctx->buffer );
+    kfree( ctx );
+    return NULL;
+  }
+
+  gfshare_ctx_dec_newshares( ctx, sharenrs );
+  return ctx;
+}
+
+/* Initialise a recombination context that reads the caller's shares in
+ * place. It has no share buffer, so its size does not depend on maxsize.
+ */
+gfshare_ctx* gfshare_ctx_init_dec_borrowed(const uint8_t* sharenrs,
+                                           uint32_t sharecount,
+                                           uint32_t threshold,
+                                           size_t maxsize)
+{
+  gfshare_ctx *ctx;
+
+  ctx = _gfshare_ctx_init_core( sharenrs, sharecount, threshold, maxsize, 0 );
+  if( ctx == NULL )
+    return NULL;
+
+  ctx->borrowed = kcalloc( sharecount, sizeof(*ctx->borrowed), GFP_KERNEL);
+  if( ctx->borrowed == NULL || _gfshare_dec_plans_alloc( ctx ) ) {
+    kfree( ctx->borrowed );
+    kfree( ctx->sharenrs );
+    kfree( ctx );
+    return NULL;
+  }
+
+  gfshare_ctx_dec_newshares( ctx, sharenrs );
+  return ctx;
+}
+
+/* Offsets of the parts of a context laid out in one block: the struct,
+ * then sharenrs, the decode plans (recombination only) and the share
+ * buffer on a cache line of its own.
+ */
+static size_t _gfshare_ctx_layout(uint32_t sharecount, uint32_t threshold,
+                                  int dec, size_t* plans, size_t* buffer)
+{
+  size_t off = ALIGN(sizeof(struct _gfshare_ctx), 8) + ALIGN(sharecount, 8);
+
+  *plans = off;
+  if( dec )
+    off += _gfshare_dec_plans_size( sharecount, threshold );
+  *buffer = ALIGN(off, 64);
+  return *buffer;
+}
+
+/* Bytes _gfshare_ctx_carve needs for these parameters, 0 if they are not
+ * valid for a context.
+ */
+size_t _gfshare_ctx_footprint(const uint8_t* sharenrs, uint32_t sharecount,
+                              uint32_t threshold, size_t maxsize, int dec)
+{
+  size_t plans, buffer;
+  int i;
+
+  if( maxsize < 1 || threshold < 1 || threshold > sharecount )
+    return 0;
+  for( i = 0; !dec && i < sharecount; i++ ) {
+    if( sharenrs[i] == 0 )
+      return 0;
+  }
+  return _gfshare_ctx_layout( sharecount, threshold, dec, &plans, &buffer ) +
+         sharecount * maxsize;
+}
+
+/* Build a context inside 'mem', which holds at least _gfshare_ctx_footprint
+ * bytes, without allocating anything.
+ */
+gfshare_ctx* _gfshare_ctx_carve(void* mem, const uint8_t* sharenrs,
+                                uint32_t sharecount, uint32_t threshold,
+                                size_t maxsize, int dec)
+{
+  gfshare_ctx* ctx = mem;
+  size_t plans, buffer;
+
+  _gfshare_ctx_layout( sharecount, threshold, dec, &plans, &buffer );
+  memset( ctx, 0, buffer );
+  ctx->sharecount = sharecount;
+  ctx->threshold = threshold;
+  ctx->maxsize = maxsize;
+  ctx->size = maxsize;
+  ctx->chunks = 1;
+  ctx->sharenrs = (uint8_t*)mem + ALIGN(sizeof(struct _gfshare_ctx), 8);
+  memcpy( ctx->sharenrs, sharenrs, sharecount );
+  ctx->buffer = (uint8_t*)mem + buffer;
+  ctx->buffersize = sharecount * maxsize;
+  _gfshare_ctx_use_gf( ctx, gfshare_gf );
+  if( dec ) {
+    _gfshare_dec_plans_carve( ctx, (uint8_t*)mem + plans );
+    gfshare_ctx_dec_newshares( ctx, sharenrs );
+  }
+  return ctx;
+}
+
+/* Wipe what a carved context has used: everything up to its buffer and
+ * the buffer itself, not the rest of the block it lives in.
+ */
+void _gfshare_ctx_wipe(gfshare_ctx* ctx)
+{
+  kfree_sensitive( ctx->stream );
+  memzero_explicit( ctx->buffer, ctx->buffersize );
+  memzero_explicit( ctx, ctx->buffer - (uint8_t*)ctx );
 }
 
 /* Set the current processing size */
@@ -203,21 +376,151 @@ int gfshare_ctx_setsize(gfshare_ctx* ctx, size_t size) {
   return 0;
 }
 
+/* Bytes in each share at the current size */
+size_t gfshare_ctx_sharesize(const gfshare_ctx* ctx) {
+  if(_gfshare_ctx_hybrid(ctx)) {
+    return GFSHARE_HYBRID_KEY + DIV_ROUND_UP(ctx->size, ctx->threshold);
+  }
+  return DIV_ROUND_UP(ctx->size, ctx->chunks);
+}
+
+/* Choose the random backend for this context's coefficients */
+int gfshare_ctx_set_rand(gfshare_ctx* ctx, const char* backend) {
+  struct gfshare_rand_backend* be = NULL;
+
+  if(backend != NULL) {
+    be = gfshare_rand_find(backend);
+    if(be == NULL) {
+      return 1;
+    }
+  }
+  ctx->rand = be;
+  return 0;
+}
+
+/* Allow (or stop) splitting and recombining across CPUs */
+void gfshare_ctx_set_parallel(gfshare_ctx* ctx, int may_sleep) {
+  ctx->parallel = may_sleep != 0;
+}
+
+/* Choose the GF(256) engine for this context's arithmetic */
+int gfshare_ctx_set_engine(gfshare_ctx* ctx, const char* engine) {
+  const struct gfshare_gf_ops* gf = gfshare_gf;
+
+  if(engine != NULL) {
+    gf = gfshare_gf_find(engine);
+    if(gf == NULL) {
+      return 1;
+    }
+  }
+  _gfshare_ctx_use_gf(ctx, gf);
+  return 0;
+}
+
 /* Free a share context's memory. */
 void gfshare_ctx_free(gfshare_ctx* ctx) {
-  gfshare_fill_rand( ctx->buffer, ctx->sharecount * ctx->maxsize );
+  if( ctx->pool ) {
+    gfshare_ctx_pool_put( ctx );
+    return;
+  }
+  if( ctx->buffer )
+    gfshare_fill_rand( ctx->buffer, ctx->buffersize );
   _gfshare_fill_rand_using_random_bytes( ctx->sharenrs, ctx->sharecount );
   kfree( ctx->sharenrs );
   kfree( ctx->buffer );
+  kfree( ctx->plans );
+  kfree( ctx->borrowed );
+  kfree_sensitive( ctx->stream );
   _gfshare_fill_rand_using_random_bytes( (uint8_t*)ctx, sizeof(struct _gfshare_ctx) );
   kfree( ctx );
 }
 
 /* --------------------------------------------------------[ Splitting ]---- */
+
+/* Fill the random coefficients, with the context's own backend if it has one */
+void _gfshare_ctx_fill_rand(const gfshare_ctx* ctx, uint8_t* buffer, size_t count) {
+  _gfshare_fill_rand_with(ctx->rand, buffer, count);
+}
+
+void _gfshare_fill_rand_with(struct gfshare_rand_backend* rand,
+                             uint8_t* buffer, size_t count) {
+  uint64_t start = gfshare_stat_begin();
+
+  if(rand != NULL) {
+    rand->generate(rand, buffer, count);
+  } else {
+    gfshare_fill_rand(buffer, count);
+  }
+  gfshare_stat_end(GFSHARE_STAT_RAND, start, count);
+}
+
 /* Provide a secret to the encoder. (this re-scrambles the coefficients) */
 void gfshare_ctx_enc_setsecret( gfshare_ctx* ctx, const uint8_t* secret) {
   memcpy(ctx->buffer + ((ctx->threshold-1) * ctx->maxsize), secret, ctx->size);
-  gfshare_fill_rand(ctx->buffer, (ctx->threshold-1) * ctx->maxsize);
+  _gfshare_ctx_fill_rand(ctx, ctx->buffer, (ctx->threshold-1) * ctx->maxsize);
+}
+
+/* Working set we try to keep the encoder's tiles within. */
+#define GFSHARE_L1_BYTES 32768
+#define GFSHARE_MIN_TILE 256
+
+/* Pick a tile so that one tile of every coefficient plus the share being
+ * updated stay resident in L1 while all shares are produced from them.
+ */
+static uint32_t _gfshare_enc_tilesize(const gfshare_ctx* ctx)
+{
+  uint32_t tile = GFSHARE_L1_BYTES / (ctx->threshold + 1);
+
+  tile &= ~63u;
+  if(tile < GFSHARE_MIN_TILE) {
+    tile = GFSHARE_MIN_TILE;
+  }
+  return tile;
+}
+
+/* Evaluate the polynomial at every share's x for one secret, over bytes
+ * [start, start + count).
+ * Coefficient c < threshold-1 is read from coeffs + c * stride, and the
+ * constant term straight from 'secret', so it never has to be copied in.
+ *
+ * The coefficients are walked once, a tile at a time, and every share
+ * is brought up to date for that tile before moving on, so memory traffic
+ * does not grow with sharecount.
+ */
+void _gfshare_enc_eval(const gfshare_ctx* ctx,
+                       const uint8_t* coeffs, size_t stride,
+                       const uint8_t* secret, uint8_t** shares,
+                       uint32_t start, uint32_t count)
+{
+  uint32_t coefficient, pos, len, tile;
+  const uint8_t* row;
+  uint64_t t0 = gfshare_stat_begin(), ts;
+  int i;
+
+  if(ctx->enc_kernel != NULL) {
+    ctx->enc_kernel(shares, coeffs, stride, secret,
+                    (const uint8_t (*)[32])ctx->enc_tbl, start, count);
+    gfshare_stat_end(GFSHARE_STAT_ENC_EVAL, t0, count);
+    return;
+  }
+
+  tile = _gfshare_enc_tilesize(ctx);
+  for(pos = start; pos < start + count; pos += tile) {
+    len = min_t(uint32_t, tile, start + count - pos);
+    for(i = 0; i < ctx->sharecount; i++) {
+      ts = gfshare_stat_begin();
+      row = ctx->threshold == 1 ? secret : coeffs;
+      memcpy(shares[i] + pos, row + pos, len);
+      for(coefficient = 1; coefficient < ctx->threshold; ++coefficient) {
+        row = coefficient == ctx->threshold - 1 ?
+              secret : coeffs + coefficient * stride;
+        ctx->gf->mul_xor(shares[i] + pos, shares[i] + pos, row + pos,
+                          ctx->sharenrs[i], len);
+      }
+      gfshare_stat_end_share(ctx->sharenrs[i], ts, len);
+    }
+  }
+  gfshare_stat_end(GFSHARE_STAT_ENC_EVAL, t0, count);
 }
 
 /* Extract a share from the context. 
@@ -228,69 +531,179 @@ int gfshare_ctx_enc_getshares(const gfshare_ctx* ctx,
 		              const uint8_t* secret,
                               uint8_t** shares)
 {
-  uint32_t pos, coefficient;
-  uint8_t *share_ptr;
-  uint64_t time;
-  int i;
+  if(_gfshare_ctx_hybrid(ctx)) {
+    _gfshare_hybrid_getshares(ctx, secret, shares);
+    return 0;
+  }
+  if(ctx->chunks > 1) {
+    _gfshare_ramp_getshares(ctx, secret, shares);
+    return 0;
+  }
+  if(_gfshare_par_getshares(ctx, secret, shares) == 0) {
+    return 0;
+  }
 
-  time = ktime_get_ns();  
-  memcpy(ctx->buffer + ((ctx->threshold-1) * ctx->maxsize), secret, ctx->size);
-  gfshare_fill_rand(ctx->buffer, (ctx->threshold-1) * ctx->maxsize);
-  printk(KERN_INFO "time to generate random bytes: %lld", ktime_get_ns() - time);
-
-  for(i = 0; i < ctx->sharecount; i++) {
-    uint32_t ilog = logs[ctx->sharenrs[i]];
-    uint8_t *coefficient_ptr = ctx->buffer;
-
-    time = ktime_get_ns();
-    memcpy(shares[i], coefficient_ptr++, ctx->size);
-    coefficient_ptr += ctx->size - 1;
-
-    for(coefficient = 1; coefficient < ctx->threshold; ++coefficient) {
-      share_ptr = shares[i];
-      coefficient_ptr = ctx->buffer + coefficient * ctx->maxsize;
-      for(pos = 0; pos < ctx->size; ++pos) {
-        uint8_t share_byte = *share_ptr;
-        if(share_byte) {
-          share_byte = exps[ilog + logs[share_byte]];
-        }
-        *share_ptr++ = share_byte ^ *coefficient_ptr++;
+  _gfshare_ctx_fill_rand(ctx, ctx->buffer, (ctx->threshold-1) * ctx->maxsize);
+  _gfshare_enc_eval(ctx, ctx->buffer, ctx->maxsize, secret, shares,
+                    0, ctx->size);
+  return 0;
+}
+
+/* Re-randomise a full set of shares in place. A fresh polynomial
+ * R(x) = x^z * H(x), with H random of degree rows - 1, is added to every
+ * share. R is zero wherever the secret lives (the constant term, the L
+ * pieces of a ramp context), so the shares now describe the same secret
+ * under new random coefficients. For a hybrid context only the key shares
+ * change; the dispersed ciphertext carries no randomness to refresh.
+ * H(x) is built by Horner in a scratch row after the coefficients, one
+ * tile at a time, and multiplied by x^z straight into the share.
+ */
+int gfshare_ctx_enc_refresh(const gfshare_ctx* ctx, uint8_t** shares)
+{
+  uint32_t rows = ctx->threshold - ctx->chunks, zero = ctx->chunks;
+  size_t len = gfshare_ctx_sharesize(ctx);
+  uint32_t pos, count, tile, r, i;
+  uint8_t x, xz, *acc;
+  uint64_t t0;
+
+  if(!_gfshare_ctx_enc(ctx)) {
+    return 1;
+  }
+  if(_gfshare_ctx_hybrid(ctx)) {
+    rows = ctx->threshold - 1;
+    zero = 1;
+    len = GFSHARE_HYBRID_KEY;
+  }
+  if(rows == 0) {
+    return 0;
+  }
+
+  acc = ctx->buffer + rows * len;
+  _gfshare_ctx_fill_rand(ctx, ctx->buffer, rows * len);
+  t0 = gfshare_stat_begin();
+  tile = _gfshare_enc_tilesize(ctx);
+  for(pos = 0; pos < len; pos += tile) {
+    count = min_t(uint32_t, tile, len - pos);
+    for(i = 0; i < ctx->sharecount; i++) {
+      x = ctx->sharenrs[i];
+      for(xz = 1, r = 0; r < zero; r++) {
+        xz = gfshare_gf_mul(xz, x);
+      }
+      memcpy(acc + pos, ctx->buffer + pos, count);
+      for(r = 1; r < rows; r++) {
+        ctx->gf->mul_xor(acc + pos, acc + pos, ctx->buffer + r * len + pos,
+                         x, count);
       }
+      ctx->gf->mul_xor(shares[i] + pos, acc + pos, shares[i] + pos, xz, count);
     }
-    printk(KERN_INFO "time to generate share: %lld", ktime_get_ns() - time);
   }
+  gfshare_stat_end(GFSHARE_STAT_ENC_EVAL, t0, len);
   return 0;
 }
 
-/* ----------------------------------------------------[ Recombination ]---- */
+/* Split 'count' secrets of 'size' bytes each in one call.
+ * shares[j][i] receives share i of secrets[j].
+ *
+ * As many secrets as fit in the context's buffer have their random
+ * coefficients packed next to each other (coefficient c of secret j at
+ * buffer + c * group * size + j * size) and produced by a single
+ * random fill.
+ */
+int gfshare_ctx_enc_getshares_batch(const gfshare_ctx* ctx,
+                                    uint32_t count,
+                                    uint8_t** secrets,
+                                    uint8_t*** shares)
+{
+  uint32_t group, base, j;
+  size_t stride;
 
-/* Inform a recombination context of a change in share indexes */
-void gfshare_ctx_dec_newshares( gfshare_ctx* ctx, const uint8_t* sharenrs) {
-  memcpy(ctx->sharenrs, sharenrs, ctx->sharecount);
+  if(!_gfshare_ctx_plain(ctx)) {
+    return 1;
+  }
+  group = min_t(uint32_t, ctx->sharecount * ctx->maxsize /
+                          max_t(uint32_t, ctx->threshold - 1, 1) / ctx->size,
+                count);
+  if(group == 0) {
+    return count ? 1 : 0;
+  }
+
+  for(base = 0; base < count; base += group) {
+    group = min_t(uint32_t, group, count - base);
+    stride = (size_t)group * ctx->size;
+    _gfshare_ctx_fill_rand(ctx, ctx->buffer, (ctx->threshold-1) * stride);
+    for(j = 0; j < group; j++) {
+      _gfshare_enc_eval(ctx, ctx->buffer + j * ctx->size, stride,
+                        secrets[base + j], shares[base + j], 0, ctx->size);
+    }
+  }
+  return 0;
 }
 
-/* Provide a share context with one of the shares.
- * The 'sharenr' is the index into the 'sharenrs' array
+/* Start splitting a secret of any length in chunks of up to 'maxsize'
+ * bytes. The coefficients come from one Speck-CTR stream under a fresh key,
+ * which carries on from chunk to chunk, so the context's random backend is
+ * not used and memory stays at what the context was created with.
  */
-int gfshare_ctx_dec_giveshare(gfshare_ctx* ctx, uint8_t sharenr, const uint8_t* share) {
-  if(sharenr >= ctx->sharecount) {
+int gfshare_ctx_enc_stream_init(gfshare_ctx* ctx)
+{
+  uint8_t key[16];
+
+  if(!_gfshare_ctx_enc(ctx) || !_gfshare_ctx_plain(ctx)) {
     return 1;
   }
-  memcpy(ctx->buffer + (sharenr * ctx->maxsize), share, ctx->size);
+  if(ctx->stream == NULL) {
+    ctx->stream = kmalloc(sizeof(*ctx->stream), GFP_KERNEL);
+    if(ctx->stream == NULL) {
+      return 1;
+    }
+  }
+  get_random_bytes(key, sizeof(key));
+  gfshare_speck_setkey(&ctx->stream->key, key);
+  memzero_explicit(key, sizeof(key));
+  ctx->stream->ctr[0] = ctx->stream->ctr[1] = 0;
   return 0;
 }
 
-/* Extract the secret by interpolation of the shares.
- * secretbuf must be allocated and at least 'size' bytes long
+/* Split the next 'len' bytes of the secret. shares[i] receives the next
+ * 'len' bytes of share i; 1 <= len <= maxsize.
  */
-void gfshare_ctx_dec_extract(const gfshare_ctx* ctx, uint8_t* secretbuf) {
+int gfshare_ctx_enc_stream_update(gfshare_ctx* ctx, const uint8_t* chunk,
+                                  size_t len, uint8_t** shares)
+{
+  uint64_t start;
+
+  if(!_gfshare_ctx_enc(ctx) || ctx->stream == NULL || len < 1 ||
+     len > ctx->maxsize) {
+    return 1;
+  }
+
+  start = gfshare_stat_begin();
+  gfshare_speck_ctr(&ctx->stream->key, ctx->stream->ctr, ctx->buffer,
+                    (ctx->threshold-1) * len);
+  gfshare_stat_end(GFSHARE_STAT_RAND, start, (ctx->threshold-1) * len);
+
+  _gfshare_enc_eval(ctx, ctx->buffer, len, chunk, shares, 0, len);
+  return 0;
+}
+
+/* Finish a streamed split and forget its key */
+void gfshare_ctx_enc_stream_final(gfshare_ctx* ctx)
+{
+  kfree_sensitive(ctx->stream);
+  ctx->stream = NULL;
+}
+
+/* ----------------------------------------------------[ Recombination ]---- */
+
+/* Compute L(i) as per Lagrange Interpolation for the first 'threshold'
+ * provided shares, keeping each as a multiply row.
+ */
+static void _gfshare_dec_plan_build(const gfshare_ctx* ctx,
+                                    struct gfshare_dec_plan* plan)
+{
   uint32_t i, j, n, jn;
-  uint8_t *secret_ptr, *share_ptr;
 
-  memset(secretbuf, 0, ctx->size);
-  
   for(n = i = 0; n < ctx->threshold && i < ctx->sharecount; ++n, ++i) {
-    /* Compute L(i) as per Lagrange Interpolation */
     unsigned Li_top = 0, Li_bottom = 0;
     
     if(ctx->sharenrs[i] == 0) {
@@ -313,13 +726,256 @@ void gfshare_ctx_dec_extract(const gfshare_ctx* ctx, uint8_t* secretbuf) {
     Li_top += 0xff - Li_bottom;
     Li_top %= 0xff;
     /* Li_top is now log(L(i)) */
-    
-    secret_ptr = secretbuf; share_ptr = ctx->buffer + (ctx->maxsize * i);
-    for(j = 0; j < ctx->size; ++j) {
-      if(*share_ptr) {
-        *secret_ptr ^= exps[Li_top + logs[*share_ptr]];
+
+    plan->index[n] = i;
+    gfshare_gf_row(exps[Li_top], plan->rows[n]);
+    gfshare_gf_nibbles(exps[Li_top], plan->nibbles[n]);
+  }
+  plan->count = n;
+  memcpy(plan->sharenrs, ctx->sharenrs, ctx->sharecount);
+}
+
+/* Inform a recombination context of a change in share indexes.
+ * The Lagrange weights for the new set are looked up in the context's
+ * small LRU of plans, and only computed if this set hasn't been seen lately.
+ */
+void gfshare_ctx_dec_newshares( gfshare_ctx* ctx, const uint8_t* sharenrs) {
+  struct gfshare_dec_plan *plan = NULL, *victim;
+  int n;
+
+  memcpy(ctx->sharenrs, sharenrs, ctx->sharecount);
+  if(ctx->plans == NULL) {
+    return; /* not a recombination context */
+  }
+
+  victim = &ctx->plans[0];
+  for(n = 0; n < GFSHARE_PLAN_CACHE && plan == NULL; n++) {
+    if(ctx->plans[n].last_used &&
+       !memcmp(ctx->plans[n].sharenrs, sharenrs, ctx->sharecount)) {
+      plan = &ctx->plans[n];
+    } else if(ctx->plans[n].last_used < victim->last_used) {
+      victim = &ctx->plans[n];
+    }
+  }
+
+  if(plan == NULL) {
+    plan = victim;
+    _gfshare_dec_plan_build(ctx, plan);
+  }
+  plan->last_used = ++ctx->plan_clock;
+  ctx->plan = plan;
+}
+
+/* Provide a share context with one of the shares.
+ * The 'sharenr' is the index into the 'sharenrs' array
+ */
+int gfshare_ctx_dec_giveshare(gfshare_ctx* ctx, uint8_t sharenr, const uint8_t* share) {
+  if(sharenr >= ctx->sharecount || ctx->buffer == NULL) {
+    return 1;
+  }
+  memcpy(ctx->buffer + (sharenr * ctx->maxsize), share,
+         gfshare_ctx_sharesize(ctx));
+  return 0;
+}
+
+/* Point a borrowed-share context at one of the shares. The share is read
+ * in place by gfshare_ctx_dec_extract, so it must stay valid until then.
+ */
+int gfshare_ctx_dec_borrowshare(gfshare_ctx* ctx, uint8_t sharenr, const uint8_t* share) {
+  if(sharenr >= ctx->sharecount || ctx->borrowed == NULL) {
+    return 1;
+  }
+  ctx->borrowed[sharenr] = share;
+  return 0;
+}
+
+/* Interpolate bytes [start, start + count) of the secret into out */
+void _gfshare_dec_extract_range(const gfshare_ctx* ctx, uint8_t* out,
+                                uint32_t start, uint32_t count) {
+  const struct gfshare_dec_plan* plan = ctx->plan;
+  const uint8_t* in[GFSHARE_SPEC_MAX_SHARES];
+  uint64_t t0 = gfshare_stat_begin();
+  uint32_t n;
+
+  if(ctx->dec_kernel != NULL && plan->count == ctx->threshold) {
+    for(n = 0; n < plan->count; ++n) {
+      in[n] = _gfshare_dec_share(ctx, plan->index[n]) + start;
+    }
+    ctx->dec_kernel(out, in, (const uint8_t (*)[32])plan->nibbles, count);
+    gfshare_stat_end(GFSHARE_STAT_DEC_INTERP, t0, count);
+    return;
+  }
+
+  memset(out, 0, count);
+
+  for(n = 0; n < plan->count; ++n) {
+    ctx->gf->mul_xor_row(out, _gfshare_dec_share(ctx, plan->index[n]) + start,
+                         out, plan->rows[n], count);
+  }
+  gfshare_stat_end(GFSHARE_STAT_DEC_INTERP, t0, count);
+}
+
+/* Extract the secret by interpolation of the shares.
+ * secretbuf must be allocated and at least 'size' bytes long
+ */
+void gfshare_ctx_dec_extract(const gfshare_ctx* ctx, uint8_t* secretbuf) {
+  if(_gfshare_ctx_hybrid(ctx)) {
+    _gfshare_hybrid_extract_range(ctx, secretbuf, 0, ctx->size);
+    return;
+  }
+  if(ctx->chunks > 1) {
+    _gfshare_ramp_extract_range(ctx, secretbuf, 0, ctx->size);
+    return;
+  }
+  if(_gfshare_par_extract(ctx, secretbuf) == 0) {
+    return;
+  }
+  _gfshare_dec_extract_range(ctx, secretbuf, 0, ctx->size);
+}
+
+/* Extract only bytes [offset, offset + len) of the secret. Only those
+ * columns of the shares are read, so the cost does not depend on 'size'.
+ */
+int gfshare_ctx_dec_extract_range(const gfshare_ctx* ctx, size_t offset,
+                                  size_t len, uint8_t* out) {
+  if(ctx->plan == NULL || offset > ctx->size || len > ctx->size - offset) {
+    return 1;
+  }
+  if(len == 0) {
+    return 0;
+  }
+  if(_gfshare_ctx_hybrid(ctx)) {
+    _gfshare_hybrid_extract_range(ctx, out, offset, len);
+  } else if(ctx->chunks > 1) {
+    _gfshare_ramp_extract_range(ctx, out, offset, len);
+  } else {
+    _gfshare_dec_extract_range(ctx, out, offset, len);
+  }
+  return 0;
+}
+
+/* Rebuild the share at x = 'sharenr' from the shares in the current plan.
+ * The weights are the Lagrange basis at that x rather than at 0,
+ * w_i = prod_{j != i} (x - x_j) / (x_i - x_j), so the secret is never
+ * formed. Plain, ramp and hybrid shares are all values of one polynomial,
+ * so the same pass serves every kind of context.
+ */
+int gfshare_ctx_repair_share(const gfshare_ctx* ctx, uint8_t sharenr,
+                             uint8_t* out) {
+  const struct gfshare_dec_plan* plan = ctx->plan;
+  const uint8_t* in[GFSHARE_SPEC_MAX_SHARES];
+  uint8_t weights[256], tbl[GFSHARE_SPEC_MAX_SHARES][32], xi, xj;
+  size_t len = gfshare_ctx_sharesize(ctx);
+  uint64_t t0;
+  uint32_t n, j;
+
+  if(plan == NULL || plan->count < ctx->threshold || sharenr == 0) {
+    return 1;
+  }
+
+  t0 = gfshare_stat_begin();
+  for(n = 0; n < plan->count; ++n) {
+    uint8_t top = 1, bottom = 1;
+
+    xi = ctx->sharenrs[plan->index[n]];
+    for(j = 0; j < plan->count; ++j) {
+      xj = ctx->sharenrs[plan->index[j]];
+      if(j != n) {
+        top = gfshare_gf_mul(top, sharenr ^ xj);
+        bottom = gfshare_gf_mul(bottom, xi ^ xj);
       }
-      share_ptr++; secret_ptr++;
     }
+    weights[n] = gfshare_gf_mul(top, exps[0xff - logs[bottom]]);
+  }
+
+  if(ctx->dec_kernel != NULL) {
+    for(n = 0; n < plan->count; ++n) {
+      in[n] = _gfshare_dec_share(ctx, plan->index[n]);
+      gfshare_gf_nibbles(weights[n], tbl[n]);
+    }
+    ctx->dec_kernel(out, in, (const uint8_t (*)[32])tbl, len);
+  } else {
+    memset(out, 0, len);
+    for(n = 0; n < plan->count; ++n) {
+      ctx->gf->mul_xor(out, _gfshare_dec_share(ctx, plan->index[n]), out,
+                       weights[n], len);
+    }
+  }
+  gfshare_stat_end(GFSHARE_STAT_DEC_INTERP, t0, len);
+  return 0;
+}
+
+/* Recombine 'count' secrets in one call, interpolating straight from the
+ * caller's buffers. shares[j][i] is share i (an index into the sharenrs
+ * array) of secret j; shares the current sharenrs mark as absent may be
+ * NULL. Each secrets[j] must be at least 'size' bytes long.
+ */
+int gfshare_ctx_dec_extract_batch(const gfshare_ctx* ctx,
+                                  uint32_t count,
+                                  uint8_t*** shares,
+                                  uint8_t** secrets)
+{
+  const struct gfshare_dec_plan* plan = ctx->plan;
+  const uint8_t* in[GFSHARE_SPEC_MAX_SHARES];
+  uint64_t t0;
+  uint32_t j, n;
+
+  if(plan == NULL || !_gfshare_ctx_plain(ctx)) {
+    return 1;
   }
+  for(j = 0; j < count; j++) {
+    t0 = gfshare_stat_begin();
+    if(ctx->dec_kernel != NULL && plan->count == ctx->threshold) {
+      for(n = 0; n < plan->count; ++n) {
+        in[n] = shares[j][plan->index[n]];
+      }
+      ctx->dec_kernel(secrets[j], in, (const uint8_t (*)[32])plan->nibbles,
+                      ctx->size);
+      gfshare_stat_end(GFSHARE_STAT_DEC_INTERP, t0, ctx->size);
+      continue;
+    }
+    memset(secrets[j], 0, ctx->size);
+    for(n = 0; n < plan->count; ++n) {
+      ctx->gf->mul_xor_row(secrets[j], shares[j][plan->index[n]],
+                           secrets[j], plan->rows[n], ctx->size);
+    }
+    gfshare_stat_end(GFSHARE_STAT_DEC_INTERP, t0, ctx->size);
+  }
+  return 0;
+}
+
+/* Recombine the next 'len' bytes of a streamed secret, 1 <= len <= maxsize,
+ * from the next 'len' bytes of each share, read in place. shares[i] is
+ * share i (an index into the sharenrs array), NULL if absent.
+ * Interpolation carries nothing from one chunk to the next, so unlike the
+ * encoder there is no stream to start or finish.
+ */
+int gfshare_ctx_dec_stream_update(const gfshare_ctx* ctx, const uint8_t** shares,
+                                  size_t len, uint8_t* chunk)
+{
+  const struct gfshare_dec_plan* plan = ctx->plan;
+  const uint8_t* in[GFSHARE_SPEC_MAX_SHARES];
+  uint64_t t0;
+  uint32_t n;
+
+  if(plan == NULL || !_gfshare_ctx_plain(ctx) || len < 1 || len > ctx->maxsize) {
+    return 1;
+  }
+
+  t0 = gfshare_stat_begin();
+  if(ctx->dec_kernel != NULL && plan->count == ctx->threshold) {
+    for(n = 0; n < plan->count; ++n) {
+      in[n] = shares[plan->index[n]];
+    }
+    ctx->dec_kernel(chunk, in, (const uint8_t (*)[32])plan->nibbles, len);
+    gfshare_stat_end(GFSHARE_STAT_DEC_INTERP, t0, len);
+    return 0;
+  }
+  memset(chunk, 0, len);
+  for(n = 0; n < plan->count; ++n) {
+    ctx->gf->mul_xor_row(chunk, shares[plan->index[n]], chunk,
+                         plan->rows[n], len);
+  }
+  gfshare_stat_end(GFSHARE_STAT_DEC_INTERP, t0, len);
+  return 0;
 }
@@ -29,6 +29,9 @@
 #include <linux/types.h>
 
 typedef struct _gfshare_ctx gfshare_ctx;
+typedef struct _gfshare16_ctx gfshare16_ctx;
+
+struct scatterlist;
 
 typedef void (*gfshare_rand_func_t)(uint8_t*, size_t);
 
@@ -39,6 +42,23 @@ typedef void (*gfshare_rand_func_t)(uint8_t*, size_t);
  */
 extern gfshare_rand_func_t gfshare_fill_rand;
 
+/* -----------------------------------------------------------[ Module ]---- */
+
+/* Select the GF(256) engine for this CPU (SSSE3/AVX2 where available, the
+ * scalar table code otherwise) and fill the per-CPU random pools.
+ * Call once at module load. Returns 0 or a negative errno.
+ */
+int gfshare_init(void);
+
+/* Release everything gfshare_init() set up. Call at module unload. */
+void gfshare_exit(void);
+
+/* Register and remove the /dev/gfshare misc device (gfshare_dev.h). Kernel
+ * module only; call after gfshare_init() and before gfshare_exit().
+ */
+int gfshare_dev_init(void);
+void gfshare_dev_exit(void);
+
 /* ------------------------------------------------------[ Preparation ]---- */
 
 /* Initialise a gfshare context for producing shares */
@@ -53,9 +73,103 @@ gfshare_ctx* gfshare_ctx_init_dec(const uint8_t* sharenrs,
                                   uint32_t threshold,
                                   size_t maxsize);
 
+/* Initialise a gfshare context for recombining shares the caller keeps
+ * alive, registered with gfshare_ctx_dec_borrowshare rather than copied in
+ * by gfshare_ctx_dec_giveshare. No per-share buffer is allocated.
+ */
+gfshare_ctx* gfshare_ctx_init_dec_borrowed(const uint8_t* sharenrs,
+                                           uint32_t sharecount,
+                                           uint32_t threshold,
+                                           size_t maxsize);
+
+/* Take a context from the context pool instead of allocating one. gfp may
+ * be GFP_ATOMIC, in which case these never sleep and fall back on a small
+ * reserve. NULL if the parameters are invalid, the context would be over
+ * 256 KiB, or nothing is left. Give pooled contexts back with
+ * gfshare_ctx_pool_put (or gfshare_ctx_free), which zeroes the context and
+ * its whole share buffer, but not the rest of the size class object it was
+ * carved from.
+ */
+gfshare_ctx* gfshare_ctx_pool_get_enc(const uint8_t* sharenrs,
+                                      uint32_t sharecount,
+                                      uint32_t threshold,
+                                      size_t maxsize,
+                                      gfp_t gfp);
+gfshare_ctx* gfshare_ctx_pool_get_dec(const uint8_t* sharenrs,
+                                      uint32_t sharecount,
+                                      uint32_t threshold,
+                                      size_t maxsize,
+                                      gfp_t gfp);
+void gfshare_ctx_pool_put(gfshare_ctx* ctx);
+
+/* Initialise a ramp (packed) context, whose shares are only about
+ * size / (threshold - privacy) bytes each. Any 'threshold' shares recover
+ * the secret and up to 'privacy' shares reveal nothing about it; in
+ * between, partial information leaks. 0 <= privacy < threshold, and
+ * privacy = threshold - 1 is ordinary sharing. Ramp contexts are used with
+ * gfshare_ctx_enc_getshares, gfshare_ctx_dec_giveshare and
+ * gfshare_ctx_dec_extract; the batch, stream and scatterlist calls refuse
+ * them.
+ */
+gfshare_ctx* gfshare_ctx_init_enc_ramp(const uint8_t* sharenrs,
+                                       uint32_t sharecount,
+                                       uint32_t threshold,
+                                       uint32_t privacy,
+                                       size_t maxsize);
+gfshare_ctx* gfshare_ctx_init_dec_ramp(const uint8_t* sharenrs,
+                                       uint32_t sharecount,
+                                       uint32_t threshold,
+                                       uint32_t privacy,
+                                       size_t maxsize);
+
+/* Initialise a hybrid context. Secrets of 64 bytes or more are encrypted
+ * under a random key, the ciphertext is dispersed so that any 'threshold'
+ * shares rebuild it, and only the key is shared the usual way. Each share
+ * is 16 + size / threshold bytes (rounded up), where plain shares are
+ * 'size'. This is computationally rather than unconditionally secure.
+ * Shorter secrets are shared as usual. threshold must be at least 2. Used
+ * like ramp contexts, with the same calls.
+ */
+gfshare_ctx* gfshare_ctx_init_enc_hybrid(const uint8_t* sharenrs,
+                                         uint32_t sharecount,
+                                         uint32_t threshold,
+                                         size_t maxsize);
+gfshare_ctx* gfshare_ctx_init_dec_hybrid(const uint8_t* sharenrs,
+                                         uint32_t sharecount,
+                                         uint32_t threshold,
+                                         size_t maxsize);
+
 /* Set the current processing size */
 int gfshare_ctx_setsize(gfshare_ctx* ctx, size_t size);
 
+/* Bytes in each share at the current size: 'size', or less for ramp and
+ * hybrid contexts
+ */
+size_t gfshare_ctx_sharesize(const gfshare_ctx* ctx);
+
+/* Generate this context's random coefficients with the named backend
+ * ("speck", "chacha20" or "aes-ctr") instead of gfshare_fill_rand.
+ * NULL goes back to gfshare_fill_rand. Returns 1 if the backend isn't
+ * available on this system.
+ */
+int gfshare_ctx_set_rand(gfshare_ctx* ctx, const char* backend);
+
+/* Let gfshare_ctx_enc_getshares and gfshare_ctx_dec_extract hand secrets
+ * of parallel_min_kb or more out to other CPUs and wait for them. Only set
+ * this if every call on the context is made where it may sleep: not under
+ * a spinlock, in an RCU read section or with preemption off. Off by
+ * default.
+ */
+void gfshare_ctx_set_parallel(gfshare_ctx* ctx, int may_sleep);
+
+/* Do this context's arithmetic with the named GF(256) engine ("scalar",
+ * "bitslice", "ssse3" or "avx2") instead of the module default. "bitslice"
+ * uses no lookup tables and never branches on share or secret bytes, so
+ * its timing is independent of the data. NULL goes back to the default.
+ * Returns 1 if the engine isn't available on this system.
+ */
+int gfshare_ctx_set_engine(gfshare_ctx* ctx, const char* engine);
+
 /* Free a share context's memory. */
 void gfshare_ctx_free(gfshare_ctx* ctx);
 
@@ -65,27 +179,219 @@ void gfshare_ctx_free(gfshare_ctx* ctx);
 void gfshare_ctx_enc_setsecret(gfshare_ctx* ctx, const uint8_t* secret);
 
 /* Extract a share from the context. 
- * 'share' must be preallocated and at least 'size' bytes long.
+ * 'share' must be preallocated and at least gfshare_ctx_sharesize bytes long.
  * 'sharenr' is the index into the 'sharenrs' array of the share you want.
  */
 int gfshare_ctx_enc_getshares(const gfshare_ctx* ctx,
 		              const uint8_t* secret,
                               uint8_t** shares);
 
+/* Refresh a full set of shares of a 'size' byte secret in place, laid out
+ * as gfshare_ctx_enc_getshares produced them. Every share changes, the
+ * secret they recombine to does not, and the secret is never formed. All
+ * 'sharecount' shares must be refreshed together: one left out no longer
+ * combines with the rest. Works on plain, ramp and hybrid contexts
+ * (hybrid shares only have their key part refreshed), but only ones made
+ * for splitting; returns 1 for a recombination context.
+ */
+int gfshare_ctx_enc_refresh(const gfshare_ctx* ctx, uint8_t** shares);
+
+/* Split 'count' secrets, each 'size' bytes long, in one call.
+ * shares[j] is the share array for secrets[j], laid out as for
+ * gfshare_ctx_enc_getshares. Randomness for as many secrets as fit in the
+ * context is generated in one go.
+ */
+int gfshare_ctx_enc_getshares_batch(const gfshare_ctx* ctx,
+                                    uint32_t count,
+                                    uint8_t** secrets,
+                                    uint8_t*** shares);
+
+/* Split a secret too large for one buffer, 'maxsize' bytes at a time:
+ * gfshare_ctx_enc_stream_init, then gfshare_ctx_enc_stream_update for each
+ * chunk in order, then gfshare_ctx_enc_stream_final. Each update writes
+ * 'len' bytes (1 <= len <= maxsize) to every shares[i]; concatenating them
+ * gives the shares of the whole secret. Random coefficients come from one
+ * keystream that continues across chunks. init and update return 1 on error,
+ * or if the context is not one for splitting.
+ */
+int gfshare_ctx_enc_stream_init(gfshare_ctx* ctx);
+int gfshare_ctx_enc_stream_update(gfshare_ctx* ctx, const uint8_t* chunk,
+                                  size_t len, uint8_t** shares);
+void gfshare_ctx_enc_stream_final(gfshare_ctx* ctx);
+
+/* As gfshare_ctx_enc_getshares, with the secret and each share in a
+ * scatterlist of 'size' bytes or more, worked on in place. On 32 bit
+ * highmem kernels at most 11 shares can be produced this way.
+ * Returns 1 if a list is too short or memory is short.
+ */
+int gfshare_ctx_enc_getshares_sg(const gfshare_ctx* ctx,
+                                 struct scatterlist* secret,
+                                 struct scatterlist** shares);
+
 /* ----------------------------------------------------[ Recombination ]---- */
 
 /* Inform a recombination context of a change in share indexes */
 void gfshare_ctx_dec_newshares(gfshare_ctx* ctx, const uint8_t* sharenrs);
 
-/* Provide a share context with one of the shares.
- * The 'sharenr' is the index into the 'sharenrs' array
+/* Provide a share context with one of the shares, gfshare_ctx_sharesize
+ * bytes long. The 'sharenr' is the index into the 'sharenrs' array
  */
 int gfshare_ctx_dec_giveshare(gfshare_ctx* ctx, uint8_t sharenr, const uint8_t* share);
 
+/* Register one of the shares with a context from
+ * gfshare_ctx_init_dec_borrowed. The share is not copied: it must be at
+ * least 'size' bytes and stay valid until gfshare_ctx_dec_extract is done.
+ * The 'sharenr' is the index into the 'sharenrs' array
+ */
+int gfshare_ctx_dec_borrowshare(gfshare_ctx* ctx, uint8_t sharenr, const uint8_t* share);
+
 /* Extract the secret by interpolation of the shares.
  * secretbuf must be allocated and at least 'size' bytes long
  */
 void gfshare_ctx_dec_extract(const gfshare_ctx* ctx, uint8_t* secretbuf);
 
+/* As gfshare_ctx_dec_extract, but with more than 'threshold' shares
+ * present, find and leave out corrupt ones: up to (m - threshold) / 2 bad
+ * shares in any one byte position, where m shares are present. bad, if
+ * not NULL, has 'sharecount' entries, set to 1 for each share found
+ * corrupt and 0 otherwise. Returns 1 if the shares are too damaged to
+ * tell which are good, memory is short or the context has more than 255
+ * share slots; the secret is not valid then.
+ */
+int gfshare_ctx_dec_extract_correct(gfshare_ctx* ctx, uint8_t* secretbuf,
+                                    uint8_t* bad);
+
+/* Extract bytes [offset, offset + len) of the secret into out[0, len),
+ * reading only the matching parts of the shares, for random access into
+ * a large secret. Works on every kind of recombination context. Returns 1
+ * if the range runs past 'size'.
+ */
+int gfshare_ctx_dec_extract_range(const gfshare_ctx* ctx, size_t offset,
+                                  size_t len, uint8_t* out);
+
+/* Regenerate the share whose x coordinate is 'sharenr' (the value the
+ * encoder had in its sharenrs array, not an index) from 'threshold' shares
+ * given to the context, without recombining the secret or drawing fresh
+ * randomness. It is identical to the share the encoder produced.
+ * 'out' must be gfshare_ctx_sharesize bytes long. Returns 1 if sharenr is
+ * 0 or fewer than 'threshold' shares are present.
+ */
+int gfshare_ctx_repair_share(const gfshare_ctx* ctx, uint8_t sharenr,
+                             uint8_t* out);
+
+/* Extract 'count' secrets, each 'size' bytes long, reading the shares in
+ * place rather than through gfshare_ctx_dec_giveshare.
+ * shares[j][i] is share i (an index into the 'sharenrs' array) of
+ * secret j and must be 'size' bytes long; absent shares may be NULL.
+ * Returns 1, extracting nothing, if no shares have been declared or the
+ * context is a ramp or hybrid one.
+ */
+int gfshare_ctx_dec_extract_batch(const gfshare_ctx* ctx,
+                                  uint32_t count,
+                                  uint8_t*** shares,
+                                  uint8_t** secrets);
+
+/* Recombine a streamed secret chunk by chunk, in any order: 'len' bytes
+ * (1 <= len <= maxsize) of the secret from the same 'len' bytes of each
+ * share, read in place. shares[i] is share i (an index into the 'sharenrs'
+ * array); absent shares may be NULL. Returns 1 if len is out of range.
+ */
+int gfshare_ctx_dec_stream_update(const gfshare_ctx* ctx, const uint8_t** shares,
+                                  size_t len, uint8_t* chunk);
+
+/* Extract the secret into a scatterlist, reading the shares in place from
+ * scatterlists. shares[i] is share i (an index into the 'sharenrs' array);
+ * absent shares may be NULL. Every list must cover 'size' bytes.
+ * Returns 1 if a list is too short or memory is short.
+ */
+int gfshare_ctx_dec_extract_sg(const gfshare_ctx* ctx,
+                               struct scatterlist** shares,
+                               struct scatterlist* secret);
+
+/* ----------------------------------------------------------[ Async ]---- */
+
+enum gfshare_job_op {
+  GFSHARE_JOB_SPLIT,     /* gfshare_ctx_enc_getshares(ctx, secret, shares) */
+  GFSHARE_JOB_COMBINE,   /* give shares[i] for each non-NULL i, then
+                            gfshare_ctx_dec_extract(ctx, secretbuf) */
+};
+
+struct gfshare_job;
+
+/* Called in process context when the job is done; err is 0 or a negative
+ * errno. The job may be freed or submitted again from here.
+ */
+typedef void (*gfshare_job_done_t)(struct gfshare_job* job, int err);
+
+struct gfshare_job {
+  enum gfshare_job_op op;
+  gfshare_ctx* ctx;
+  const uint8_t* secret;
+  uint8_t** shares;        /* [sharecount], indexed like 'sharenrs' */
+  uint8_t* secretbuf;
+  gfshare_job_done_t done;
+  void* priv;              /* for the caller */
+  struct gfshare_job* next; /* private to the library */
+};
+
+/* Queue a job without waiting for it. Jobs complete in submission order.
+ * The job and everything it points at belong to the library until
+ * job->done is called; one context must not be in two jobs at once.
+ * Callable from any context. Returns 0, -EBUSY if async_depth jobs are
+ * already queued, -EINVAL for a malformed job, or -ENODEV after
+ * gfshare_exit().
+ */
+int gfshare_job_submit(struct gfshare_job* job);
+
+/* ---------------------------------------------------[ GF(2^16) mode ]---- */
+
+/* The same scheme over GF(2^16), for up to 65535 shares. Share numbers are
+ * 16 bit, nonzero for splitting and distinct. Shares are
+ * gfshare16_ctx_sharesize bytes: the secret's length rounded up to even.
+ * Shares from this mode and the GF(256) one don't mix.
+ */
+gfshare16_ctx* gfshare16_ctx_init_enc(const uint16_t* sharenrs,
+                                      uint32_t sharecount,
+                                      uint32_t threshold,
+                                      size_t maxsize);
+
+/* As gfshare_ctx_init_dec; a zero in sharenrs marks a share not present */
+gfshare16_ctx* gfshare16_ctx_init_dec(const uint16_t* sharenrs,
+                                      uint32_t sharecount,
+                                      uint32_t threshold,
+                                      size_t maxsize);
+
+/* Set the secret size, 1 <= size < maxsize as for gfshare_ctx_setsize (a
+ * new context starts at maxsize). Returns 1 if out of range.
+ */
+int gfshare16_ctx_setsize(gfshare16_ctx* ctx, size_t size);
+
+/* As gfshare_ctx_set_rand, for the coefficients of a GF(2^16) split */
+int gfshare16_ctx_set_rand(gfshare16_ctx* ctx, const char* backend);
+
+/* Length of each share for the current size */
+size_t gfshare16_ctx_sharesize(const gfshare16_ctx* ctx);
+
+/* Wipe and free a GF(2^16) context */
+void gfshare16_ctx_free(gfshare16_ctx* ctx);
+
+/* Split 'size' bytes of secret into 'sharecount' shares */
+int gfshare16_ctx_enc_getshares(const gfshare16_ctx* ctx,
+                                const uint8_t* secret, uint8_t** shares);
+
+/* Say which shares are present, as for gfshare_ctx_dec_newshares. The first
+ * 'threshold' nonzero entries are the ones used.
+ */
+void gfshare16_ctx_dec_newshares(gfshare16_ctx* ctx, const uint16_t* sharenrs);
+
+/* Provide share 'sharenr' (an index into the sharenrs array). Returns 1 if
+ * the index is out of range.
+ */
+int gfshare16_ctx_dec_giveshare(gfshare16_ctx* ctx, uint32_t sharenr,
+                                const uint8_t* share);
+
+/* Extract 'size' bytes of secret */
+void gfshare16_ctx_dec_extract(const gfshare16_ctx* ctx, uint8_t* secretbuf);
+
 #endif /* LIBGFSHARE_H */
 
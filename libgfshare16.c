@@ -0,0 +1,540 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Sharing over GF(2^16), for up to 65535 share holders.
+ *
+ * Symbols are 16 bits, reduced by x^16 + x^12 + x^3 + x + 1. Rather than
+ * 64K entry log/exp tables, each multiply by a constant c uses eight 16
+ * entry tables built for that c by linearity: the low and high byte of c
+ * times each nibble of the symbol. AVX2 does those lookups with vpshufb,
+ * the scalar path with four loads per byte. The tables are 128 bytes per
+ * constant, so they are built once: for every share number when a split
+ * context is set up, and for every weight in dec_newshares. The few
+ * general multiplies the Lagrange weights need are done bit by bit.
+ *
+ * So that the vector code needs no shuffling between bytes and symbols,
+ * data is cut into 64 byte blocks holding 32 symbols: the 32 low bytes
+ * first, then the 32 high bytes. A tail of 2h < 64 bytes is laid out the
+ * same way with h symbols. Shares are the secret's length rounded up to
+ * even; an odd secret is padded with a zero byte.
+ */
+
+#include "libgfshare_internal.h"
+
+#include <linux/bitops.h>
+#include <linux/kernel.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#ifdef CONFIG_X86_64
+#include <asm/fpu/api.h>
+#include <asm/simd.h>
+#endif
+
+#define GFSHARE16_POLY 0x100b
+#define GFSHARE16_BLOCK 64
+
+/* Working set the encoder's tiles are kept within, as for GF(256) */
+#define GFSHARE16_L1_BYTES 32768
+#define GFSHARE16_MIN_TILE 256
+
+struct _gfshare16_ctx {
+  uint32_t sharecount;
+  uint32_t threshold;
+  size_t maxsize;
+  size_t size;
+  size_t stride;         /* maxsize rounded up to even */
+  uint16_t* sharenrs;
+  uint8_t* buffer;       /* splitting: threshold rows, recombining: sharecount */
+  size_t buffersize;
+  /* Splitting: [sharecount] tables of each sharenr. Recombining:
+   * [threshold] tables of the Lagrange weights of the shares in 'used'.
+   */
+  struct gfshare16_tbl* tbl;
+  uint32_t* used;
+  uint32_t nused;
+  /* Coefficient generator for this context, NULL for gfshare_fill_rand */
+  struct gfshare_rand_backend* rand;
+};
+
+/* Multiply tables for one constant c: nib[2q + h][n] is byte h of
+ * c * (n << 4q), q = 0..3
+ */
+struct gfshare16_tbl {
+  uint8_t nib[8][16];
+};
+
+static int gfshare16_avx2;
+
+/* --------------------------------------------------------[ GF(2^16) ]---- */
+
+uint16_t gfshare16_mul(uint16_t a, uint16_t b)
+{
+  uint32_t r = 0;
+  int i;
+
+  for(i = 0; i < 16; i++) {
+    r ^= (uint32_t)a & -(uint32_t)((b >> i) & 1);
+    a = (a << 1) ^ (GFSHARE16_POLY & -(a >> 15));
+  }
+  return r;
+}
+
+/* a^(2^16 - 2), for a != 0 */
+static uint16_t _gfshare16_inv(uint16_t a)
+{
+  uint16_t r = 1;
+  int i;
+
+  for(i = 0; i < 15; i++) {
+    a = gfshare16_mul(a, a);
+    r = gfshare16_mul(r, a);
+  }
+  return r;
+}
+
+static void _gfshare16_tables(uint16_t c, struct gfshare16_tbl* t)
+{
+  uint16_t basis[16], y;
+  int q, i, x;
+
+  basis[0] = c;
+  for(i = 1; i < 16; i++) {
+    basis[i] = (basis[i - 1] << 1) ^ (GFSHARE16_POLY & -(basis[i - 1] >> 15));
+  }
+  for(q = 0; q < 4; q++) {
+    for(x = 0; x < 16; x++) {
+      for(y = 0, i = 0; i < 4; i++) {
+        y ^= basis[4 * q + i] & -((x >> i) & 1);
+      }
+      t->nib[2 * q][x] = y & 0xff;
+      t->nib[2 * q + 1][x] = y >> 8;
+    }
+  }
+}
+
+/* out = c*a ^ b over one block of h symbols (2h bytes) */
+static void _gfshare16_block_scalar(uint8_t* out, const uint8_t* a,
+                                    const uint8_t* b,
+                                    const struct gfshare16_tbl* t, size_t h)
+{
+  const uint8_t (*n)[16] = t->nib;
+  uint8_t lo, hi;
+  size_t s;
+
+  for(s = 0; s < h; s++) {
+    lo = a[s];
+    hi = a[h + s];
+    out[s] = n[0][lo & 15] ^ n[2][lo >> 4] ^ n[4][hi & 15] ^ n[6][hi >> 4] ^
+             b[s];
+    out[h + s] = n[1][lo & 15] ^ n[3][lo >> 4] ^ n[5][hi & 15] ^
+                 n[7][hi >> 4] ^ b[h + s];
+  }
+}
+
+#ifdef CONFIG_X86_64
+
+#define GFSHARE16_FPU_CHUNK 4096
+
+static const uint8_t gfshare16_mask[16] __aligned(16) = {
+  0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+  0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f };
+
+/* len must be a non-zero multiple of 64. ymm8-15 hold the nibble tables */
+static void _gfshare16_blocks_avx2(uint8_t* out, const uint8_t* a,
+                                   const uint8_t* b,
+                                   const struct gfshare16_tbl* t, size_t len)
+{
+  size_t i = 0;
+
+  asm volatile(
+    "vbroadcasti128 0x00(%[t]), %%ymm8\n\t"
+    "vbroadcasti128 0x10(%[t]), %%ymm9\n\t"
+    "vbroadcasti128 0x20(%[t]), %%ymm10\n\t"
+    "vbroadcasti128 0x30(%[t]), %%ymm11\n\t"
+    "vbroadcasti128 0x40(%[t]), %%ymm12\n\t"
+    "vbroadcasti128 0x50(%[t]), %%ymm13\n\t"
+    "vbroadcasti128 0x60(%[t]), %%ymm14\n\t"
+    "vbroadcasti128 0x70(%[t]), %%ymm15\n\t"
+    "vbroadcasti128 %[mask], %%ymm7\n\t"
+    "1:\n\t"
+    "vmovdqu (%[a],%[i]), %%ymm0\n\t"
+    "vmovdqu 32(%[a],%[i]), %%ymm1\n\t"
+    "vpsrlw  $4, %%ymm0, %%ymm2\n\t"
+    "vpsrlw  $4, %%ymm1, %%ymm3\n\t"
+    "vpand   %%ymm7, %%ymm0, %%ymm0\n\t"
+    "vpand   %%ymm7, %%ymm1, %%ymm1\n\t"
+    "vpand   %%ymm7, %%ymm2, %%ymm2\n\t"
+    "vpand   %%ymm7, %%ymm3, %%ymm3\n\t"
+    "vpshufb %%ymm0, %%ymm8, %%ymm4\n\t"
+    "vpshufb %%ymm0, %%ymm9, %%ymm5\n\t"
+    "vpshufb %%ymm2, %%ymm10, %%ymm6\n\t"
+    "vpxor   %%ymm6, %%ymm4, %%ymm4\n\t"
+    "vpshufb %%ymm2, %%ymm11, %%ymm6\n\t"
+    "vpxor   %%ymm6, %%ymm5, %%ymm5\n\t"
+    "vpshufb %%ymm1, %%ymm12, %%ymm6\n\t"
+    "vpxor   %%ymm6, %%ymm4, %%ymm4\n\t"
+    "vpshufb %%ymm1, %%ymm13, %%ymm6\n\t"
+    "vpxor   %%ymm6, %%ymm5, %%ymm5\n\t"
+    "vpshufb %%ymm3, %%ymm14, %%ymm6\n\t"
+    "vpxor   %%ymm6, %%ymm4, %%ymm4\n\t"
+    "vpshufb %%ymm3, %%ymm15, %%ymm6\n\t"
+    "vpxor   %%ymm6, %%ymm5, %%ymm5\n\t"
+    "vpxor   (%[b],%[i]), %%ymm4, %%ymm4\n\t"
+    "vpxor   32(%[b],%[i]), %%ymm5, %%ymm5\n\t"
+    "vmovdqu %%ymm4, (%[out],%[i])\n\t"
+    "vmovdqu %%ymm5, 32(%[out],%[i])\n\t"
+    "add     $64, %[i]\n\t"
+    "cmp     %[len], %[i]\n\t"
+    "jb      1b\n\t"
+    "vzeroupper\n\t"
+    : [i] "+r" (i)
+    : [out] "r" (out), [a] "r" (a), [b] "r" (b), [len] "r" (len),
+      [t] "r" (t->nib), [mask] "m" (gfshare16_mask)
+    : "memory", "cc");
+}
+
+#endif /* CONFIG_X86_64 */
+
+/* out = c*a ^ b over 'len' bytes (even) starting on a block boundary;
+ * out may alias a or b.
+ */
+static void _gfshare16_mul_xor(uint8_t* out, const uint8_t* a,
+                               const uint8_t* b,
+                               const struct gfshare16_tbl* t, size_t len)
+{
+  size_t pos = 0;
+
+#ifdef CONFIG_X86_64
+  if(gfshare16_avx2 && len >= GFSHARE16_BLOCK && may_use_simd()) {
+    size_t chunk;
+
+    while(len - pos >= GFSHARE16_BLOCK) {
+      chunk = min_t(size_t, len - pos, GFSHARE16_FPU_CHUNK) &
+              ~(size_t)(GFSHARE16_BLOCK - 1);
+      kernel_fpu_begin();
+      _gfshare16_blocks_avx2(out + pos, a + pos, b + pos, t, chunk);
+      kernel_fpu_end();
+      pos += chunk;
+    }
+  }
+#endif
+  for(; len - pos >= GFSHARE16_BLOCK; pos += GFSHARE16_BLOCK) {
+    _gfshare16_block_scalar(out + pos, a + pos, b + pos, t,
+                            GFSHARE16_BLOCK / 2);
+  }
+  if(pos < len) {
+    _gfshare16_block_scalar(out + pos, a + pos, b + pos, t, (len - pos) / 2);
+  }
+}
+
+/* --------------------------------------------------------[ Contexts ]---- */
+
+static gfshare16_ctx* _gfshare16_ctx_init_core(const uint16_t* sharenrs,
+                                               uint32_t sharecount,
+                                               uint32_t threshold,
+                                               size_t maxsize,
+                                               uint32_t rows, uint32_t tbls)
+{
+  gfshare16_ctx* ctx;
+  unsigned long* seen;
+  uint32_t i;
+
+  /* Size must be nonzero and the buffer addressable, and
+   * 1 <= threshold <= sharecount <= 65535
+   */
+  if(maxsize < 1 || maxsize >= SIZE_MAX / rows - 1 || threshold < 1 ||
+     threshold > sharecount || sharecount > 0xffff) {
+    return NULL;
+  }
+  /* Share numbers must be distinct; a bitmap keeps this linear */
+  seen = kcalloc(BITS_TO_LONGS(0x10000), sizeof(unsigned long), GFP_KERNEL);
+  if(seen == NULL) {
+    return NULL;
+  }
+  for(i = 0; i < sharecount; i++) {
+    if(sharenrs[i] && __test_and_set_bit(sharenrs[i], seen)) {
+      kfree(seen);
+      return NULL;
+    }
+  }
+  kfree(seen);
+
+  ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+  if(ctx == NULL) {
+    return NULL;
+  }
+  ctx->sharecount = sharecount;
+  ctx->threshold = threshold;
+  ctx->maxsize = maxsize;
+  ctx->size = maxsize;
+  ctx->stride = ALIGN(maxsize, 2);
+  ctx->buffersize = rows * ctx->stride;
+  ctx->sharenrs = kmalloc_array(sharecount, sizeof(uint16_t), GFP_KERNEL);
+  ctx->tbl = kvmalloc_array(tbls, sizeof(*ctx->tbl), GFP_KERNEL);
+  ctx->buffer = kmalloc(ctx->buffersize, GFP_KERNEL);
+  if(ctx->sharenrs == NULL || ctx->tbl == NULL || ctx->buffer == NULL) {
+    gfshare16_ctx_free(ctx);
+    return NULL;
+  }
+  memcpy(ctx->sharenrs, sharenrs, sharecount * sizeof(uint16_t));
+  return ctx;
+}
+
+/* Initialise a GF(2^16) context for producing shares */
+gfshare16_ctx* gfshare16_ctx_init_enc(const uint16_t* sharenrs,
+                                      uint32_t sharecount,
+                                      uint32_t threshold,
+                                      size_t maxsize)
+{
+  gfshare16_ctx* ctx;
+  uint32_t i;
+
+  for(i = 0; i < sharecount; i++) {
+    if(sharenrs[i] == 0) {
+      return NULL;
+    }
+  }
+  ctx = _gfshare16_ctx_init_core(sharenrs, sharecount, threshold, maxsize,
+                                 threshold, sharecount);
+  if(ctx != NULL) {
+    for(i = 0; i < sharecount; i++) {
+      _gfshare16_tables(sharenrs[i], &ctx->tbl[i]);
+    }
+  }
+  return ctx;
+}
+
+/* Initialise a GF(2^16) context for recombining shares */
+gfshare16_ctx* gfshare16_ctx_init_dec(const uint16_t* sharenrs,
+                                      uint32_t sharecount,
+                                      uint32_t threshold,
+                                      size_t maxsize)
+{
+  gfshare16_ctx* ctx;
+
+  ctx = _gfshare16_ctx_init_core(sharenrs, sharecount, threshold, maxsize,
+                                 sharecount, threshold);
+  if(ctx == NULL) {
+    return NULL;
+  }
+  ctx->used = kmalloc_array(threshold, sizeof(uint32_t), GFP_KERNEL);
+  if(ctx->used == NULL) {
+    gfshare16_ctx_free(ctx);
+    return NULL;
+  }
+  gfshare16_ctx_dec_newshares(ctx, sharenrs);
+  return ctx;
+}
+
+int gfshare16_ctx_setsize(gfshare16_ctx* ctx, size_t size)
+{
+  if(size < 1 || size >= ctx->maxsize) {
+    return 1;
+  }
+  ctx->size = size;
+  return 0;
+}
+
+int gfshare16_ctx_set_rand(gfshare16_ctx* ctx, const char* backend)
+{
+  struct gfshare_rand_backend* be = NULL;
+
+  if(backend != NULL) {
+    be = gfshare_rand_find(backend);
+    if(be == NULL) {
+      return 1;
+    }
+  }
+  ctx->rand = be;
+  return 0;
+}
+
+size_t gfshare16_ctx_sharesize(const gfshare16_ctx* ctx)
+{
+  return ALIGN(ctx->size, 2);
+}
+
+void gfshare16_ctx_free(gfshare16_ctx* ctx)
+{
+  if(ctx->buffer != NULL) {
+    memzero_explicit(ctx->buffer, ctx->buffersize);
+  }
+  kfree(ctx->buffer);
+  kfree(ctx->sharenrs);
+  kvfree(ctx->tbl);
+  kfree(ctx->used);
+  kfree_sensitive(ctx);
+}
+
+/* --------------------------------------------------------[ Splitting ]---- */
+
+/* Rows 0..threshold-2 of the buffer are the random coefficients from the
+ * top degree down, and the last row the secret, padded to even; each row
+ * is one share long. As in _gfshare_enc_eval, the rows are walked once, a
+ * tile at a time, and every share is brought up to date for that tile
+ * before moving on. Tiles are whole blocks, so the symbol layout is the
+ * same as for one pass over the share.
+ */
+int gfshare16_ctx_enc_getshares(const gfshare16_ctx* ctx,
+                                const uint8_t* secret, uint8_t** shares)
+{
+  size_t len = gfshare16_ctx_sharesize(ctx);
+  size_t tile = GFSHARE16_L1_BYTES / ((size_t)ctx->threshold + 1);
+  uint8_t* top = ctx->buffer + (size_t)(ctx->threshold - 1) * len;
+  size_t pos, n;
+  uint64_t t0;
+  uint32_t i, c;
+
+  tile = max_t(size_t, tile & ~(size_t)(GFSHARE16_BLOCK - 1),
+               GFSHARE16_MIN_TILE);
+  _gfshare_fill_rand_with(ctx->rand, ctx->buffer,
+                          (size_t)(ctx->threshold - 1) * len);
+  memcpy(top, secret, ctx->size);
+  if(len != ctx->size) {
+    top[len - 1] = 0;
+  }
+
+  t0 = gfshare_stat_begin();
+  for(pos = 0; pos < len; pos += n) {
+    n = min_t(size_t, tile, len - pos);
+    for(i = 0; i < ctx->sharecount; i++) {
+      memcpy(shares[i] + pos, ctx->buffer + pos, n);
+      for(c = 1; c < ctx->threshold; c++) {
+        _gfshare16_mul_xor(shares[i] + pos, shares[i] + pos,
+                           ctx->buffer + (size_t)c * len + pos,
+                           &ctx->tbl[i], n);
+      }
+    }
+  }
+  gfshare_stat_end(GFSHARE_STAT_ENC_EVAL, t0, ctx->size);
+  memzero_explicit(top, len);
+  return 0;
+}
+
+/* ----------------------------------------------------[ Recombination ]---- */
+
+/* Tables for the Lagrange weights at 0 of the first 'threshold' shares
+ * present
+ */
+void gfshare16_ctx_dec_newshares(gfshare16_ctx* ctx, const uint16_t* sharenrs)
+{
+  uint32_t i, j, n, jn;
+  uint16_t top, bottom;
+
+  memcpy(ctx->sharenrs, sharenrs, ctx->sharecount * sizeof(uint16_t));
+  for(n = i = 0; n < ctx->threshold && i < ctx->sharecount; i++) {
+    if(sharenrs[i] == 0) {
+      continue;
+    }
+    top = bottom = 1;
+    for(jn = j = 0; jn < ctx->threshold && j < ctx->sharecount; j++) {
+      if(sharenrs[j] == 0) {
+        continue;
+      }
+      jn++;
+      if(i != j) {
+        top = gfshare16_mul(top, sharenrs[j]);
+        bottom = gfshare16_mul(bottom, sharenrs[i] ^ sharenrs[j]);
+      }
+    }
+    _gfshare16_tables(gfshare16_mul(top, _gfshare16_inv(bottom)),
+                      &ctx->tbl[n]);
+    ctx->used[n++] = i;
+  }
+  ctx->nused = n;
+}
+
+int gfshare16_ctx_dec_giveshare(gfshare16_ctx* ctx, uint32_t sharenr,
+                                const uint8_t* share)
+{
+  if(sharenr >= ctx->sharecount) {
+    return 1;
+  }
+  memcpy(ctx->buffer + (size_t)sharenr * ctx->stride, share,
+         gfshare16_ctx_sharesize(ctx));
+  return 0;
+}
+
+/* The whole blocks of the secret go straight into secretbuf, and the rest
+ * (at most one block, counting the pad byte of an odd secret) through a
+ * bounce buffer.
+ */
+void gfshare16_ctx_dec_extract(const gfshare16_ctx* ctx, uint8_t* secretbuf)
+{
+  size_t len = gfshare16_ctx_sharesize(ctx);
+  size_t body = ctx->size & ~(size_t)(GFSHARE16_BLOCK - 1);
+  uint8_t tail[GFSHARE16_BLOCK];
+  const uint8_t* share;
+  uint64_t t0 = gfshare_stat_begin();
+  uint32_t n;
+
+  memset(secretbuf, 0, body);
+  memset(tail, 0, sizeof(tail));
+  for(n = 0; n < ctx->nused; n++) {
+    share = ctx->buffer + (size_t)ctx->used[n] * ctx->stride;
+    _gfshare16_mul_xor(secretbuf, share, secretbuf, &ctx->tbl[n], body);
+    _gfshare16_mul_xor(tail, share + body, tail, &ctx->tbl[n], len - body);
+  }
+  memcpy(secretbuf + body, tail, ctx->size - body);
+  memzero_explicit(tail, sizeof(tail));
+  gfshare_stat_end(GFSHARE_STAT_DEC_INTERP, t0, ctx->size);
+}
+
+/* -----------------------------------------------------------[ Module ]---- */
+
+#define GFSHARE16_SELFTEST_LEN 230 /* 3 blocks and a 38 byte tail */
+
+/* Use AVX2 if the CPU has it and it agrees with the scalar path */
+void gfshare16_init(void)
+{
+  uint8_t a[GFSHARE16_SELFTEST_LEN], b[GFSHARE16_SELFTEST_LEN];
+  uint8_t want[GFSHARE16_SELFTEST_LEN], got[GFSHARE16_SELFTEST_LEN];
+  static const uint16_t cs[] = { 0x0000, 0x0001, 0x0002, 0x8001, 0xbeef };
+  struct gfshare16_tbl t;
+  int i, n;
+
+  gfshare16_avx2 = 0;
+  if(!gfshare_cpu_has_avx2()) {
+    return;
+  }
+  for(i = 0; i < GFSHARE16_SELFTEST_LEN; i++) {
+    a[i] = i * 167 + 13;
+    b[i] = i * 59 + 101;
+  }
+  for(n = 0; n < ARRAY_SIZE(cs); n++) {
+    _gfshare16_tables(cs[n], &t);
+    gfshare16_avx2 = 0;
+    _gfshare16_mul_xor(want, a, b, &t, GFSHARE16_SELFTEST_LEN);
+    gfshare16_avx2 = 1;
+    _gfshare16_mul_xor(got, a, b, &t, GFSHARE16_SELFTEST_LEN);
+    if(memcmp(want, got, GFSHARE16_SELFTEST_LEN)) {
+      gfshare16_avx2 = 0;
+      printk(KERN_WARNING "gfshare: avx2 GF(2^16) engine failed self-test\n");
+      return;
+    }
+  }
+}
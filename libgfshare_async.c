@@ -0,0 +1,238 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Asynchronous split and combine.
+ *
+ * gfshare_job_submit only links the job onto a bounded FIFO, so it can be
+ * called from any context. A single dispatcher work item drains the FIFO up
+ * to GFSHARE_ASYNC_BATCH jobs per lock round trip and runs them in order,
+ * calling each job's completion in process context.
+ *
+ * Within a batch, random generation is pipelined with evaluation: while the
+ * dispatcher evaluates job N, a helper work item on another CPU fills the
+ * coefficient rows of job N + 1 if that is a plain split. Secrets big enough
+ * for the parallel path are left to it, as it already spreads the random
+ * fill over its own workers.
+ */
+
+#include "libgfshare_internal.h"
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+static unsigned int async_depth = 256;
+module_param(async_depth, uint, 0644);
+MODULE_PARM_DESC(async_depth, "Most jobs queued by gfshare_job_submit before it returns -EBUSY");
+
+#define GFSHARE_ASYNC_BATCH 32
+
+static struct workqueue_struct* gfshare_async_wq;
+static struct work_struct gfshare_async_work;
+
+/* The FIFO, and whether the dispatcher is queued or running */
+static DEFINE_SPINLOCK(gfshare_async_lock);
+static struct gfshare_job* gfshare_async_head;
+static struct gfshare_job* gfshare_async_tail;
+static unsigned int gfshare_async_queued;
+static bool gfshare_async_busy;
+static bool gfshare_async_open;
+
+/* The coefficient fill running ahead of the dispatcher */
+static struct work_struct gfshare_async_fill_work;
+static struct gfshare_job* gfshare_async_fill_job;
+
+static bool _gfshare_async_prefillable(const struct gfshare_job* job)
+{
+  const gfshare_ctx* ctx = job->ctx;
+
+  return job->op == GFSHARE_JOB_SPLIT && _gfshare_ctx_plain(ctx) &&
+         ctx->threshold > 1 && !_gfshare_par_wanted(ctx);
+}
+
+static void _gfshare_async_fill(struct work_struct* work)
+{
+  const gfshare_ctx* ctx = gfshare_async_fill_job->ctx;
+
+  _gfshare_ctx_fill_rand(ctx, ctx->buffer, (ctx->threshold - 1) * ctx->maxsize);
+}
+
+/* Returns 0 or a negative errno for the completion */
+static int _gfshare_async_exec(struct gfshare_job* job, bool filled)
+{
+  gfshare_ctx* ctx = job->ctx;
+  uint32_t i;
+  int err;
+
+  if(job->op == GFSHARE_JOB_SPLIT) {
+    if(filled) {
+      _gfshare_enc_eval(ctx, ctx->buffer, ctx->maxsize, job->secret,
+                        job->shares, 0, ctx->size);
+      return 0;
+    }
+    return gfshare_ctx_enc_getshares(ctx, job->secret, job->shares) ? -EINVAL : 0;
+  }
+
+  for(i = 0; i < ctx->sharecount; i++) {
+    if(job->shares[i] == NULL) {
+      continue;
+    }
+    if(ctx->borrowed != NULL) {
+      err = gfshare_ctx_dec_borrowshare(ctx, i, job->shares[i]);
+    } else {
+      err = gfshare_ctx_dec_giveshare(ctx, i, job->shares[i]);
+    }
+    if(err) {
+      return -EINVAL;
+    }
+  }
+  gfshare_ctx_dec_extract(ctx, job->secretbuf);
+  return 0;
+}
+
+/* Pop up to GFSHARE_ASYNC_BATCH jobs, or mark the dispatcher idle */
+static uint32_t _gfshare_async_take(struct gfshare_job** batch)
+{
+  unsigned long flags;
+  uint32_t n = 0;
+
+  spin_lock_irqsave(&gfshare_async_lock, flags);
+  while(n < GFSHARE_ASYNC_BATCH && gfshare_async_head != NULL) {
+    batch[n++] = gfshare_async_head;
+    gfshare_async_head = gfshare_async_head->next;
+  }
+  if(gfshare_async_head == NULL) {
+    gfshare_async_tail = NULL;
+  }
+  gfshare_async_queued -= n;
+  if(n == 0) {
+    gfshare_async_busy = false;
+  }
+  spin_unlock_irqrestore(&gfshare_async_lock, flags);
+  return n;
+}
+
+static void _gfshare_async_dispatch(struct work_struct* work)
+{
+  struct gfshare_job* batch[GFSHARE_ASYNC_BATCH];
+  struct gfshare_job* job;
+  bool filling = false, filled;
+  uint32_t n, i;
+  int err;
+
+  while((n = _gfshare_async_take(batch)) != 0) {
+    for(i = 0; i < n; i++) {
+      job = batch[i];
+      filled = filling;
+      if(filling) {
+        flush_work(&gfshare_async_fill_work);
+        filling = false;
+      }
+      if(i + 1 < n && _gfshare_async_prefillable(batch[i + 1])) {
+        gfshare_async_fill_job = batch[i + 1];
+        queue_work(gfshare_async_wq, &gfshare_async_fill_work);
+        filling = true;
+      }
+      err = _gfshare_async_exec(job, filled);
+      /* The completion may free or resubmit the job */
+      job->done(job, err);
+    }
+  }
+}
+
+/* Queue a split or combine. The job and everything it points at (context,
+ * secret, shares) belong to the library until job->done is called.
+ */
+int gfshare_job_submit(struct gfshare_job* job)
+{
+  unsigned long flags;
+  bool kick = false;
+  int err = 0;
+
+  if(job->done == NULL || job->ctx == NULL || job->shares == NULL ||
+     (job->op == GFSHARE_JOB_SPLIT && job->secret == NULL) ||
+     (job->op == GFSHARE_JOB_COMBINE && job->secretbuf == NULL) ||
+     (job->op != GFSHARE_JOB_SPLIT && job->op != GFSHARE_JOB_COMBINE)) {
+    return -EINVAL;
+  }
+
+  job->next = NULL;
+  spin_lock_irqsave(&gfshare_async_lock, flags);
+  if(!gfshare_async_open) {
+    err = -ENODEV;
+  } else if(gfshare_async_queued >= READ_ONCE(async_depth)) {
+    err = -EBUSY;
+  } else {
+    if(gfshare_async_tail != NULL) {
+      gfshare_async_tail->next = job;
+    } else {
+      gfshare_async_head = job;
+    }
+    gfshare_async_tail = job;
+    gfshare_async_queued++;
+    if(!gfshare_async_busy) {
+      gfshare_async_busy = kick = true;
+    }
+  }
+  spin_unlock_irqrestore(&gfshare_async_lock, flags);
+
+  if(kick) {
+    queue_work(gfshare_async_wq, &gfshare_async_work);
+  }
+  return err;
+}
+
+int gfshare_async_init(void)
+{
+  unsigned long flags;
+
+  gfshare_async_wq = alloc_workqueue("gfshare_async", WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+  if(gfshare_async_wq == NULL) {
+    return -ENOMEM;
+  }
+  INIT_WORK(&gfshare_async_work, _gfshare_async_dispatch);
+  INIT_WORK(&gfshare_async_fill_work, _gfshare_async_fill);
+  spin_lock_irqsave(&gfshare_async_lock, flags);
+  gfshare_async_open = true;
+  spin_unlock_irqrestore(&gfshare_async_lock, flags);
+  return 0;
+}
+
+/* Refuse new jobs and run the queued ones to completion */
+void gfshare_async_exit(void)
+{
+  unsigned long flags;
+
+  if(gfshare_async_wq == NULL) {
+    return;
+  }
+  spin_lock_irqsave(&gfshare_async_lock, flags);
+  gfshare_async_open = false;
+  spin_unlock_irqrestore(&gfshare_async_lock, flags);
+  flush_work(&gfshare_async_work);
+  destroy_workqueue(gfshare_async_wq);
+  gfshare_async_wq = NULL;
+}
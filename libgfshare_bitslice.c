@@ -0,0 +1,155 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Bitsliced GF(256) engine: no tables and no data-dependent branches.
+ *
+ * 64 bytes are loaded as eight 64 bit words and transposed so that word i
+ * holds bit i of every byte. Multiplying by a constant c is linear over
+ * GF(2): bit j of c*x is the XOR of bit i of x over the i where bit j of
+ * c*x^i is set. So the product is a fixed network of 64 AND/XOR steps
+ * against masks computed once per call. The transpose is its own inverse.
+ * Short tails are padded to a full block on the stack, so the access
+ * pattern only depends on the length.
+ */
+
+#include "libgfshare_internal.h"
+
+#include <linux/kernel.h>
+#include <linux/string.h>
+
+#define GFSHARE_BS_BLOCK 64
+
+/* Swap the bits of b selected by m with the bits of a n places above them */
+#define GFSHARE_SWAPMOVE(a, b, m, n)                \
+  do {                                              \
+    uint64_t _t = (((a) >> (n)) ^ (b)) & (m);       \
+    (b) ^= _t;                                      \
+    (a) ^= _t << (n);                               \
+  } while(0)
+
+/* Transpose the 8x8 bit matrix in every byte lane of x0..x7 */
+#define GFSHARE_BS_TRANSPOSE(x0, x1, x2, x3, x4, x5, x6, x7)     \
+  do {                                                          \
+    GFSHARE_SWAPMOVE(x0, x1, 0x5555555555555555ull, 1);         \
+    GFSHARE_SWAPMOVE(x2, x3, 0x5555555555555555ull, 1);         \
+    GFSHARE_SWAPMOVE(x4, x5, 0x5555555555555555ull, 1);         \
+    GFSHARE_SWAPMOVE(x6, x7, 0x5555555555555555ull, 1);         \
+    GFSHARE_SWAPMOVE(x0, x2, 0x3333333333333333ull, 2);         \
+    GFSHARE_SWAPMOVE(x1, x3, 0x3333333333333333ull, 2);         \
+    GFSHARE_SWAPMOVE(x4, x6, 0x3333333333333333ull, 2);         \
+    GFSHARE_SWAPMOVE(x5, x7, 0x3333333333333333ull, 2);         \
+    GFSHARE_SWAPMOVE(x0, x4, 0x0f0f0f0f0f0f0f0full, 4);         \
+    GFSHARE_SWAPMOVE(x1, x5, 0x0f0f0f0f0f0f0f0full, 4);         \
+    GFSHARE_SWAPMOVE(x2, x6, 0x0f0f0f0f0f0f0f0full, 4);         \
+    GFSHARE_SWAPMOVE(x3, x7, 0x0f0f0f0f0f0f0f0full, 4);         \
+  } while(0)
+
+/* mask[i][j] is all ones when bit j of c*x^i is set, all zeros otherwise */
+static void _gfshare_bs_masks(uint8_t c, uint64_t mask[8][8])
+{
+  uint8_t p = c;
+  int i, j;
+
+  for(i = 0; i < 8; i++) {
+    for(j = 0; j < 8; j++) {
+      mask[i][j] = -(uint64_t)((p >> j) & 1);
+    }
+    p = (p << 1) ^ (0x1d & -(p >> 7));
+  }
+}
+
+/* Output plane j of the product */
+#define GFSHARE_BS_PLANE(m, j)                                  \
+  ((x0 & m[0][j]) ^ (x1 & m[1][j]) ^ (x2 & m[2][j]) ^           \
+   (x3 & m[3][j]) ^ (x4 & m[4][j]) ^ (x5 & m[5][j]) ^           \
+   (x6 & m[6][j]) ^ (x7 & m[7][j]))
+
+/* One block: out = c*a ^ b, where out may alias a or b */
+static inline void _gfshare_bs_block(uint8_t* out, const uint8_t* a,
+                                     const uint8_t* b,
+                                     const uint64_t mask[8][8])
+{
+  uint64_t x0, x1, x2, x3, x4, x5, x6, x7;
+  uint64_t y0, y1, y2, y3, y4, y5, y6, y7;
+  uint64_t w[8];
+
+  memcpy(w, a, GFSHARE_BS_BLOCK);
+  x0 = w[0]; x1 = w[1]; x2 = w[2]; x3 = w[3];
+  x4 = w[4]; x5 = w[5]; x6 = w[6]; x7 = w[7];
+  GFSHARE_BS_TRANSPOSE(x0, x1, x2, x3, x4, x5, x6, x7);
+  y0 = GFSHARE_BS_PLANE(mask, 0);
+  y1 = GFSHARE_BS_PLANE(mask, 1);
+  y2 = GFSHARE_BS_PLANE(mask, 2);
+  y3 = GFSHARE_BS_PLANE(mask, 3);
+  y4 = GFSHARE_BS_PLANE(mask, 4);
+  y5 = GFSHARE_BS_PLANE(mask, 5);
+  y6 = GFSHARE_BS_PLANE(mask, 6);
+  y7 = GFSHARE_BS_PLANE(mask, 7);
+  GFSHARE_BS_TRANSPOSE(y0, y1, y2, y3, y4, y5, y6, y7);
+  memcpy(w, b, GFSHARE_BS_BLOCK);
+  w[0] ^= y0; w[1] ^= y1; w[2] ^= y2; w[3] ^= y3;
+  w[4] ^= y4; w[5] ^= y5; w[6] ^= y6; w[7] ^= y7;
+  memcpy(out, w, GFSHARE_BS_BLOCK);
+}
+
+static void _gfshare_mul_xor_bitslice(uint8_t* out, const uint8_t* a,
+                                      const uint8_t* b, uint8_t c, size_t len)
+{
+  uint64_t mask[8][8];
+  uint8_t ta[GFSHARE_BS_BLOCK], tb[GFSHARE_BS_BLOCK];
+  size_t pos, tail;
+
+  _gfshare_bs_masks(c, mask);
+  for(pos = 0; len - pos >= GFSHARE_BS_BLOCK; pos += GFSHARE_BS_BLOCK) {
+    _gfshare_bs_block(out + pos, a + pos, b + pos,
+                      (const uint64_t (*)[8])mask);
+  }
+
+  tail = len - pos;
+  if(tail) {
+    memset(ta, 0, sizeof(ta));
+    memset(tb, 0, sizeof(tb));
+    memcpy(ta, a + pos, tail);
+    memcpy(tb, b + pos, tail);
+    _gfshare_bs_block(ta, ta, tb, (const uint64_t (*)[8])mask);
+    memcpy(out + pos, ta, tail);
+    memzero_explicit(ta, sizeof(ta));
+    memzero_explicit(tb, sizeof(tb));
+  }
+}
+
+/* The multiplier of a row is row[1] */
+static void _gfshare_mul_xor_row_bitslice(uint8_t* out, const uint8_t* a,
+                                          const uint8_t* b, const uint8_t* row,
+                                          size_t len)
+{
+  _gfshare_mul_xor_bitslice(out, a, b, row[1], len);
+}
+
+const struct gfshare_gf_ops gfshare_gf_bitslice = {
+  .name = "bitslice",
+  .mul_xor = _gfshare_mul_xor_bitslice,
+  .mul_xor_row = _gfshare_mul_xor_row_bitslice,
+};
@@ -0,0 +1,153 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Pooled contexts.
+ *
+ * A pooled context is laid out in one block (see _gfshare_ctx_carve) taken
+ * from the smallest of a few size-class kmem_caches it fits in. Each class
+ * also has a mempool holding ctx_pool_reserve blocks back, so GFP_ATOMIC
+ * callers still get a context when the slab can't supply one. Returning a
+ * context only zeroes the bytes it used; there is no PRNG scrub and no
+ * trip back to the page allocator.
+ */
+
+#include "libgfshare_internal.h"
+
+#include <linux/kernel.h>
+#include <linux/mempool.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+
+static unsigned int ctx_pool_reserve = 4;
+module_param(ctx_pool_reserve, uint, 0444);
+MODULE_PARM_DESC(ctx_pool_reserve, "Pooled contexts held in reserve per size class");
+
+struct gfshare_ctx_class {
+    const char *name;
+    size_t size;
+    struct kmem_cache *cache;
+    mempool_t *reserve;
+};
+
+static struct gfshare_ctx_class gfshare_ctx_classes[] = {
+    { "gfshare_ctx_1k", 1024 },
+    { "gfshare_ctx_4k", 4 * 1024 },
+    { "gfshare_ctx_16k", 16 * 1024 },
+    { "gfshare_ctx_64k", 64 * 1024 },
+    { "gfshare_ctx_256k", 256 * 1024 },
+};
+
+static gfshare_ctx *gfshare_ctx_pool_get(const uint8_t *sharenrs, uint32_t sharecount,
+                                         uint32_t threshold, size_t maxsize,
+                                         int dec, gfp_t gfp)
+{
+    struct gfshare_ctx_class *class = NULL;
+    size_t need;
+    gfshare_ctx *ctx;
+    void *mem;
+    int i;
+
+    need = _gfshare_ctx_footprint(sharenrs, sharecount, threshold, maxsize, dec);
+    if (!need)
+        return NULL;
+    for (i = 0; i < ARRAY_SIZE(gfshare_ctx_classes); i++) {
+        if (gfshare_ctx_classes[i].reserve && need <= gfshare_ctx_classes[i].size) {
+            class = &gfshare_ctx_classes[i];
+            break;
+        }
+    }
+    if (!class)
+        return NULL;
+
+    mem = mempool_alloc(class->reserve, gfp);
+    if (!mem)
+        return NULL;
+    ctx = _gfshare_ctx_carve(mem, sharenrs, sharecount, threshold, maxsize, dec);
+    ctx->pool = class;
+    return ctx;
+}
+
+/**
+ * Take a context for producing shares from the pool. With GFP_ATOMIC
+ * this never sleeps. Returns NULL for invalid parameters, for contexts
+ * larger than the biggest size class, or when the pool is exhausted.
+ */
+gfshare_ctx *gfshare_ctx_pool_get_enc(const uint8_t *sharenrs, uint32_t sharecount,
+                                      uint32_t threshold, size_t maxsize, gfp_t gfp)
+{
+    return gfshare_ctx_pool_get(sharenrs, sharecount, threshold, maxsize, 0, gfp);
+}
+
+/* As gfshare_ctx_pool_get_enc, for recombining shares */
+gfshare_ctx *gfshare_ctx_pool_get_dec(const uint8_t *sharenrs, uint32_t sharecount,
+                                      uint32_t threshold, size_t maxsize, gfp_t gfp)
+{
+    return gfshare_ctx_pool_get(sharenrs, sharecount, threshold, maxsize, 1, gfp);
+}
+
+/* Wipe a pooled context and give it back; gfshare_ctx_free comes here too */
+void gfshare_ctx_pool_put(gfshare_ctx *ctx)
+{
+    struct gfshare_ctx_class *class = ctx->pool;
+
+    _gfshare_ctx_wipe(ctx);
+    mempool_free(ctx, class->reserve);
+}
+
+void gfshare_ctx_pool_exit(void)
+{
+    struct gfshare_ctx_class *class;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(gfshare_ctx_classes); i++) {
+        class = &gfshare_ctx_classes[i];
+        mempool_destroy(class->reserve);
+        kmem_cache_destroy(class->cache);
+        class->reserve = NULL;
+        class->cache = NULL;
+    }
+}
+
+int gfshare_ctx_pool_init(void)
+{
+    struct gfshare_ctx_class *class;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(gfshare_ctx_classes); i++) {
+        class = &gfshare_ctx_classes[i];
+        class->cache = kmem_cache_create(class->name, class->size, 64,
+                                         SLAB_HWCACHE_ALIGN, NULL);
+        if (!class->cache)
+            goto fail;
+        class->reserve = mempool_create_slab_pool(ctx_pool_reserve, class->cache);
+        if (!class->reserve)
+            goto fail;
+    }
+    return 0;
+
+fail:
+    gfshare_ctx_pool_exit();
+    return -ENOMEM;
+}
@@ -0,0 +1,456 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* /dev/gfshare: split and combine for userspace through shared rings.
+ *
+ * Every open file owns one vmalloc'd region, mapped into the client and
+ * laid out as gfshare_dev.h describes. GFSHARE_IOC_ENTER consumes the
+ * submission queue under the file's submit lock: each sqe is copied out of
+ * the shared page and checked once, then becomes a gfshare_job on the
+ * library's async queue with its secret and shares pointing straight into
+ * the data area. Splits use a pooled context, combines a borrowed-share
+ * context, so nothing is copied on the way in or out. Completions are
+ * posted from the job callback under cq_lock. The kernel keeps its own
+ * copies of sq_head and cq_tail and never trusts the client's; it stops
+ * consuming sqes while completions in flight could overrun the completion
+ * queue, so cq_overflow only counts if the client corrupts cq_head. It also
+ * stops once the file has dev_inflight jobs queued, so that one client
+ * cannot take all of the library's async_depth.
+ */
+
+#include "libgfshare.h"
+#include "gfshare_dev.h"
+
+#include <linux/atomic.h>
+#include <linux/bitmap.h>
+#include <linux/fs.h>
+#include <linux/kernel.h>
+#include <linux/kref.h>
+#include <linux/log2.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/overflow.h>
+#include <linux/poll.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+
+static unsigned int dev_inflight = 64;
+module_param(dev_inflight, uint, 0644);
+MODULE_PARM_DESC(dev_inflight, "Most jobs one open /dev/gfshare may have in flight");
+
+struct gfshare_dev_ring {
+    struct kref ref;            /* the file and each job in flight */
+    struct mutex submit_lock;   /* setup and sq consumption */
+    spinlock_t cq_lock;
+    wait_queue_head_t wait;
+    void *mem;                  /* NULL until GFSHARE_IOC_SETUP, then fixed */
+    size_t map_size;
+    struct gfshare_dev_rings *hdr;
+    struct gfshare_sqe *sqes;
+    struct gfshare_cqe *cqes;
+    uint8_t *data;
+    size_t data_size;
+    uint32_t sq_entries, cq_entries;
+    uint32_t sq_head;           /* kernel copies of the shared indices */
+    uint32_t cq_tail;
+    atomic_t inflight;
+};
+
+struct gfshare_dev_job {
+    struct gfshare_job job;
+    struct gfshare_dev_ring *ring;
+    uint64_t user_data;
+    uint8_t *shares[];
+};
+
+static void gfshare_dev_ring_free(struct kref *ref)
+{
+    struct gfshare_dev_ring *ring = container_of(ref, struct gfshare_dev_ring, ref);
+
+    vfree(ring->mem);
+    kfree(ring);
+}
+
+/* Completions posted but not yet consumed by the client */
+static uint32_t gfshare_dev_cq_ready(struct gfshare_dev_ring *ring)
+{
+    return min(ring->cq_tail - READ_ONCE(ring->hdr->cq_head), ring->cq_entries);
+}
+
+static void gfshare_dev_post(struct gfshare_dev_ring *ring, uint64_t user_data,
+                             int res)
+{
+    struct gfshare_cqe *cqe;
+    unsigned long flags;
+
+    spin_lock_irqsave(&ring->cq_lock, flags);
+    if (ring->cq_tail - READ_ONCE(ring->hdr->cq_head) >= ring->cq_entries) {
+        WRITE_ONCE(ring->hdr->cq_overflow, ring->hdr->cq_overflow + 1);
+    } else {
+        cqe = &ring->cqes[ring->cq_tail & (ring->cq_entries - 1)];
+        cqe->user_data = user_data;
+        cqe->res = res;
+        cqe->flags = 0;
+        ring->cq_tail++;
+        smp_store_release(&ring->hdr->cq_tail, ring->cq_tail);
+    }
+    spin_unlock_irqrestore(&ring->cq_lock, flags);
+    wake_up_all(&ring->wait);
+}
+
+static void gfshare_dev_job_done(struct gfshare_job *job, int err)
+{
+    struct gfshare_dev_job *dj = container_of(job, struct gfshare_dev_job, job);
+    struct gfshare_dev_ring *ring = dj->ring;
+
+    gfshare_ctx_free(job->ctx);
+    gfshare_dev_post(ring, dj->user_data, err);
+    atomic_dec(&ring->inflight);
+    kfree(dj);
+    wake_up_all(&ring->wait);
+    kref_put(&ring->ref, gfshare_dev_ring_free);
+}
+
+/* Whether [off, off + len) lies inside the data area */
+static bool gfshare_dev_range(struct gfshare_dev_ring *ring, uint64_t off,
+                              uint64_t len)
+{
+    return off <= ring->data_size && len <= ring->data_size - off;
+}
+
+/* Check a copied sqe and read its share numbers */
+static int gfshare_dev_check(struct gfshare_dev_ring *ring,
+                             const struct gfshare_sqe *sqe, uint8_t *sharenrs)
+{
+    DECLARE_BITMAP(seen, 256);
+    uint64_t span;
+    uint32_t i, present = 0;
+
+    if ((sqe->op != GFSHARE_OP_SPLIT && sqe->op != GFSHARE_OP_COMBINE) ||
+        sqe->size == 0 || sqe->threshold == 0 || sqe->sharecount > 255 ||
+        sqe->threshold > sqe->sharecount)
+        return -EINVAL;
+    /* A split context holds every share, in one kmalloc */
+    if ((uint64_t)sqe->sharecount * sqe->size > GFSHARE_DEV_MAX_SQE_BYTES)
+        return -E2BIG;
+
+    /* The last share ends at shares_off + (n - 1) * stride + size */
+    if (sqe->share_stride < sqe->size ||
+        check_mul_overflow(sqe->share_stride, (uint64_t)sqe->sharecount - 1, &span) ||
+        check_add_overflow(span, (uint64_t)sqe->size, &span))
+        return -EINVAL;
+    if (!gfshare_dev_range(ring, sqe->sharenrs_off, sqe->sharecount) ||
+        !gfshare_dev_range(ring, sqe->secret_off, sqe->size) ||
+        !gfshare_dev_range(ring, sqe->shares_off, span))
+        return -EFAULT;
+
+    memcpy(sharenrs, ring->data + sqe->sharenrs_off, sqe->sharecount);
+    bitmap_zero(seen, 256);
+    for (i = 0; i < sqe->sharecount; i++) {
+        if (sharenrs[i] == 0) {
+            if (sqe->op == GFSHARE_OP_SPLIT)
+                return -EINVAL;
+            continue;
+        }
+        if (__test_and_set_bit(sharenrs[i], seen))
+            return -EINVAL;
+        present++;
+    }
+    return present < sqe->threshold ? -EINVAL : 0;
+}
+
+/* Queue one sqe. -EBUSY means the async queue is full and the sqe should
+ * be tried again later; any other error is the sqe's own.
+ */
+static int gfshare_dev_submit(struct gfshare_dev_ring *ring,
+                              const struct gfshare_sqe *sqe)
+{
+    struct gfshare_dev_job *dj;
+    uint8_t sharenrs[255];
+    gfshare_ctx *ctx;
+    uint32_t i;
+    int err;
+
+    err = gfshare_dev_check(ring, sqe, sharenrs);
+    if (err)
+        return err;
+
+    dj = kzalloc(struct_size(dj, shares, sqe->sharecount), GFP_KERNEL);
+    if (!dj)
+        return -ENOMEM;
+    if (sqe->op == GFSHARE_OP_SPLIT) {
+        ctx = gfshare_ctx_pool_get_enc(sharenrs, sqe->sharecount,
+                                       sqe->threshold, sqe->size, GFP_KERNEL);
+        if (!ctx)
+            ctx = gfshare_ctx_init_enc(sharenrs, sqe->sharecount,
+                                       sqe->threshold, sqe->size);
+    } else {
+        ctx = gfshare_ctx_init_dec_borrowed(sharenrs, sqe->sharecount,
+                                            sqe->threshold, sqe->size);
+    }
+    if (!ctx) {
+        kfree(dj);
+        return -ENOMEM;
+    }
+    /* Only ever used by the async worker, which may sleep */
+    gfshare_ctx_set_parallel(ctx, 1);
+
+    for (i = 0; i < sqe->sharecount; i++) {
+        if (sharenrs[i])
+            dj->shares[i] = ring->data + sqe->shares_off + i * sqe->share_stride;
+    }
+    dj->ring = ring;
+    dj->user_data = sqe->user_data;
+    dj->job.op = sqe->op == GFSHARE_OP_SPLIT ? GFSHARE_JOB_SPLIT : GFSHARE_JOB_COMBINE;
+    dj->job.ctx = ctx;
+    dj->job.shares = dj->shares;
+    dj->job.secret = ring->data + sqe->secret_off;
+    dj->job.secretbuf = ring->data + sqe->secret_off;
+    dj->job.done = gfshare_dev_job_done;
+
+    kref_get(&ring->ref);
+    atomic_inc(&ring->inflight);
+    err = gfshare_job_submit(&dj->job);
+    if (err) {
+        atomic_dec(&ring->inflight);
+        kref_put(&ring->ref, gfshare_dev_ring_free);
+        gfshare_ctx_free(ctx);
+        kfree(dj);
+    }
+    return err;
+}
+
+/* Consume up to 'count' sqes; returns how many were */
+static uint32_t gfshare_dev_consume(struct gfshare_dev_ring *ring, uint32_t count)
+{
+    struct gfshare_sqe sqe;
+    uint32_t tail, n;
+    int err;
+
+    tail = smp_load_acquire(&ring->hdr->sq_tail);
+    for (n = 0; n < count && ring->sq_head != tail; n++) {
+        /* Room for this completion on top of every one still owed, and
+         * within this file's share of the async queue
+         */
+        if (gfshare_dev_cq_ready(ring) + atomic_read(&ring->inflight) >=
+            ring->cq_entries ||
+            atomic_read(&ring->inflight) >= READ_ONCE(dev_inflight))
+            break;
+        memcpy(&sqe, &ring->sqes[ring->sq_head & (ring->sq_entries - 1)],
+               sizeof(sqe));
+        err = gfshare_dev_submit(ring, &sqe);
+        if (err == -EBUSY)
+            break;
+        if (err)
+            gfshare_dev_post(ring, sqe.user_data, err);
+        ring->sq_head++;
+        smp_store_release(&ring->hdr->sq_head, ring->sq_head);
+    }
+    return n;
+}
+
+static long gfshare_dev_enter(struct gfshare_dev_ring *ring,
+                              struct gfshare_dev_enter __user *uarg)
+{
+    struct gfshare_dev_enter arg;
+    uint32_t n;
+    int err;
+
+    if (copy_from_user(&arg, uarg, sizeof(arg)))
+        return -EFAULT;
+
+    mutex_lock(&ring->submit_lock);
+    if (!ring->mem) {
+        mutex_unlock(&ring->submit_lock);
+        return -ENXIO;
+    }
+    n = gfshare_dev_consume(ring, arg.to_submit);
+    mutex_unlock(&ring->submit_lock);
+
+    if (arg.min_complete) {
+        err = wait_event_interruptible(ring->wait,
+                gfshare_dev_cq_ready(ring) >= arg.min_complete ||
+                atomic_read(&ring->inflight) == 0);
+        if (err && n == 0)
+            return err;
+    }
+    return n;
+}
+
+static long gfshare_dev_setup(struct gfshare_dev_ring *ring,
+                              struct gfshare_dev_params __user *uarg)
+{
+    struct gfshare_dev_params p;
+    size_t sq_off, cq_off, data_off, map_size;
+    long err = 0;
+    void *mem;
+
+    if (copy_from_user(&p, uarg, sizeof(p)))
+        return -EFAULT;
+    if (p.cq_entries == 0)
+        p.cq_entries = 2 * p.sq_entries;
+    if (p.sq_entries == 0 || p.sq_entries > GFSHARE_DEV_MAX_ENTRIES ||
+        p.cq_entries > 2 * GFSHARE_DEV_MAX_ENTRIES ||
+        p.data_size == 0 || p.data_size > GFSHARE_DEV_MAX_DATA)
+        return -EINVAL;
+    p.sq_entries = roundup_pow_of_two(p.sq_entries);
+    p.cq_entries = roundup_pow_of_two(p.cq_entries);
+
+    sq_off = ALIGN(sizeof(struct gfshare_dev_rings), 64);
+    cq_off = sq_off + p.sq_entries * sizeof(struct gfshare_sqe);
+    data_off = PAGE_ALIGN(cq_off + p.cq_entries * sizeof(struct gfshare_cqe));
+    map_size = data_off + PAGE_ALIGN(p.data_size);
+
+    mutex_lock(&ring->submit_lock);
+    if (ring->mem) {
+        err = -EBUSY;
+        goto out;
+    }
+    mem = vmalloc_user(map_size);
+    if (!mem) {
+        err = -ENOMEM;
+        goto out;
+    }
+    ring->map_size = map_size;
+    ring->hdr = mem;
+    ring->sqes = mem + sq_off;
+    ring->cqes = mem + cq_off;
+    ring->data = mem + data_off;
+    ring->data_size = p.data_size;
+    ring->sq_entries = p.sq_entries;
+    ring->cq_entries = p.cq_entries;
+    ring->hdr->sq_mask = p.sq_entries - 1;
+    ring->hdr->cq_mask = p.cq_entries - 1;
+    /* poll() looks at the ring without the lock */
+    smp_store_release(&ring->mem, mem);
+
+    p.sq_off = sq_off;
+    p.cq_off = cq_off;
+    p.data_off = data_off;
+    p.map_size = map_size;
+    if (copy_to_user(uarg, &p, sizeof(p)))
+        err = -EFAULT;
+out:
+    mutex_unlock(&ring->submit_lock);
+    return err;
+}
+
+static long gfshare_dev_ioctl(struct file *file, unsigned int cmd,
+                              unsigned long arg)
+{
+    struct gfshare_dev_ring *ring = file->private_data;
+
+    switch (cmd) {
+    case GFSHARE_IOC_SETUP:
+        return gfshare_dev_setup(ring, (void __user *)arg);
+    case GFSHARE_IOC_ENTER:
+        return gfshare_dev_enter(ring, (void __user *)arg);
+    default:
+        return -ENOTTY;
+    }
+}
+
+static int gfshare_dev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    struct gfshare_dev_ring *ring = file->private_data;
+    int err = -ENXIO;
+
+    mutex_lock(&ring->submit_lock);
+    if (ring->mem && vma->vm_pgoff == 0 &&
+        vma->vm_end - vma->vm_start <= ring->map_size)
+        err = remap_vmalloc_range(vma, ring->mem, 0);
+    mutex_unlock(&ring->submit_lock);
+    return err;
+}
+
+static __poll_t gfshare_dev_poll(struct file *file, poll_table *wait)
+{
+    struct gfshare_dev_ring *ring = file->private_data;
+    __poll_t mask = 0;
+
+    poll_wait(file, &ring->wait, wait);
+    if (smp_load_acquire(&ring->mem) && gfshare_dev_cq_ready(ring))
+        mask = EPOLLIN | EPOLLRDNORM;
+    return mask;
+}
+
+static int gfshare_dev_open(struct inode *inode, struct file *file)
+{
+    struct gfshare_dev_ring *ring;
+
+    ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+    if (!ring)
+        return -ENOMEM;
+    kref_init(&ring->ref);
+    mutex_init(&ring->submit_lock);
+    spin_lock_init(&ring->cq_lock);
+    init_waitqueue_head(&ring->wait);
+    atomic_set(&ring->inflight, 0);
+    file->private_data = ring;
+    return 0;
+}
+
+/* Jobs in flight keep the ring, and so the data area, alive */
+static int gfshare_dev_release(struct inode *inode, struct file *file)
+{
+    struct gfshare_dev_ring *ring = file->private_data;
+
+    kref_put(&ring->ref, gfshare_dev_ring_free);
+    return 0;
+}
+
+static const struct file_operations gfshare_dev_fops = {
+    .owner = THIS_MODULE,
+    .open = gfshare_dev_open,
+    .release = gfshare_dev_release,
+    .unlocked_ioctl = gfshare_dev_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
+    .mmap = gfshare_dev_mmap,
+    .poll = gfshare_dev_poll,
+    .llseek = noop_llseek,
+};
+
+static struct miscdevice gfshare_dev_misc = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name = "gfshare",
+    .fops = &gfshare_dev_fops,
+    .mode = 0600,
+};
+
+int gfshare_dev_init(void)
+{
+    return misc_register(&gfshare_dev_misc);
+}
+
+void gfshare_dev_exit(void)
+{
+    misc_deregister(&gfshare_dev_misc);
+}
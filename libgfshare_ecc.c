@@ -0,0 +1,239 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Error-correcting recombination from more than 'threshold' shares.
+ *
+ * m shares of a degree k-1 polynomial at distinct x_i form a generalised
+ * Reed-Solomon codeword, so every column of bytes satisfies the m - k
+ * parity checks
+ *
+ *   S_j = sum_i v_i x_i^j y_i = 0,  0 <= j < m - k,
+ *   v_i = 1 / prod_{l != i} (x_i - x_l).
+ *
+ * The syndromes are worked out a tile of columns at a time with the
+ * context's engine, so clean data costs m - k multiply-accumulate passes.
+ * A column whose syndromes are not all zero has S_j = sum (v_i e_i) x_i^j
+ * over its bad shares; Berlekamp-Massey gives the error locator from them,
+ * and its roots among the x_i^-1 name the shares at fault. Up to
+ * (m - k) / 2 of them can be found in any one column. The shares found bad
+ * in any column are then dropped, and the secret is recombined from the
+ * rest through the ordinary path of whatever kind of context this is.
+ */
+
+#include "libgfshare_internal.h"
+#include "libgfshare_tables.h"
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+/* Columns per syndrome tile */
+#define GFSHARE_ECC_TILE 512
+
+struct gfshare_ecc_state {
+  uint32_t m;            /* shares present */
+  uint32_t checks;       /* m - threshold */
+  uint8_t idx[256];      /* their indexes into sharenrs */
+  uint8_t x[256];
+  uint8_t xinv[256];
+  uint8_t v[256];
+  uint8_t lambda[256];   /* Berlekamp-Massey state */
+  uint8_t prev[256];
+  uint8_t tmp[256];
+  uint8_t sharenrs[256]; /* the caller's set, to put back */
+  uint8_t syn[];         /* [checks][GFSHARE_ECC_TILE] */
+};
+
+static uint8_t _gfshare_ecc_inv(uint8_t a)
+{
+  return exps[0xff - logs[a]];
+}
+
+/* Locate the bad shares of one column from its syndromes s[0..checks).
+ * Sets bad[] for each and returns 0, or 1 if there are too many to tell.
+ */
+static int _gfshare_ecc_locate(struct gfshare_ecc_state* st, const uint8_t* s,
+                               uint8_t* bad)
+{
+  uint8_t *c = st->lambda, *b = st->prev, d, db = 1, coef, sum, p;
+  uint32_t len = 0, shift = 1, n, i, roots = 0;
+
+  memset(c, 0, st->checks + 1);
+  memset(b, 0, st->checks + 1);
+  c[0] = b[0] = 1;
+  for(n = 0; n < st->checks; n++) {
+    d = s[n];
+    for(i = 1; i <= len; i++) {
+      d ^= gfshare_gf_mul(c[i], s[n - i]);
+    }
+    if(d == 0) {
+      shift++;
+      continue;
+    }
+    coef = gfshare_gf_mul(d, _gfshare_ecc_inv(db));
+    memcpy(st->tmp, c, st->checks + 1);
+    for(i = 0; i + shift <= st->checks; i++) {
+      c[i + shift] ^= gfshare_gf_mul(coef, b[i]);
+    }
+    if(2 * len <= n) {
+      len = n + 1 - len;
+      memcpy(b, st->tmp, st->checks + 1);
+      db = d;
+      shift = 1;
+    } else {
+      shift++;
+    }
+  }
+  if(2 * len > st->checks) {
+    return 1;
+  }
+
+  /* Lambda(z) = prod (1 - x_i z) over the bad i */
+  for(i = 0; i < st->m; i++) {
+    sum = 0;
+    for(p = 1, n = 0; n <= len; n++) {
+      sum ^= gfshare_gf_mul(c[n], p);
+      p = gfshare_gf_mul(p, st->xinv[i]);
+    }
+    if(sum == 0) {
+      bad[st->idx[i]] = 1;
+      roots++;
+    }
+  }
+  return roots != len;
+}
+
+/* Check every column and mark the shares found bad */
+static int _gfshare_ecc_scan(const gfshare_ctx* ctx,
+                             struct gfshare_ecc_state* st, uint8_t* bad)
+{
+  size_t len = gfshare_ctx_sharesize(ctx), pos, count, col;
+  uint8_t s[256], w;
+  const uint8_t* y;
+  uint32_t i, j;
+
+  for(pos = 0; pos < len; pos += count) {
+    count = min_t(size_t, GFSHARE_ECC_TILE, len - pos);
+    memset(st->syn, 0, st->checks * GFSHARE_ECC_TILE);
+    for(i = 0; i < st->m; i++) {
+      y = _gfshare_dec_share(ctx, st->idx[i]) + pos;
+      for(w = st->v[i], j = 0; j < st->checks; j++) {
+        ctx->gf->mul_xor(st->syn + j * GFSHARE_ECC_TILE, y,
+                         st->syn + j * GFSHARE_ECC_TILE, w, count);
+        w = gfshare_gf_mul(w, st->x[i]);
+      }
+    }
+    for(col = 0; col < count; col++) {
+      for(w = 0, j = 0; j < st->checks; j++) {
+        s[j] = st->syn[j * GFSHARE_ECC_TILE + col];
+        w |= s[j];
+      }
+      if(w && _gfshare_ecc_locate(st, s, bad)) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/* Recombine, correcting bad shares among the ones present */
+int gfshare_ctx_dec_extract_correct(gfshare_ctx* ctx, uint8_t* secretbuf,
+                                    uint8_t* bad)
+{
+  struct gfshare_ecc_state* st;
+  uint8_t found[256];
+  uint32_t i, l, m = 0, dropped = 0;
+  int ret = 1;
+
+  /* The state below has room for every possible x value, and no more */
+  if(ctx->plan == NULL || ctx->sharecount > 255) {
+    return 1;
+  }
+  for(i = 0; i < ctx->sharecount; i++) {
+    m += ctx->sharenrs[i] != 0;
+  }
+  memset(found, 0, ctx->sharecount);
+  if(m <= ctx->threshold) {
+    /* nothing to check against */
+    if(bad != NULL) {
+      memcpy(bad, found, ctx->sharecount);
+    }
+    gfshare_ctx_dec_extract(ctx, secretbuf);
+    return 0;
+  }
+
+  st = kmalloc(sizeof(*st) + (m - ctx->threshold) * GFSHARE_ECC_TILE,
+               GFP_KERNEL);
+  if(st == NULL) {
+    return 1;
+  }
+  st->m = m;
+  st->checks = m - ctx->threshold;
+  memcpy(st->sharenrs, ctx->sharenrs, ctx->sharecount);
+  for(m = 0, i = 0; i < ctx->sharecount; i++) {
+    if(ctx->sharenrs[i] != 0) {
+      st->idx[m] = i;
+      st->x[m] = ctx->sharenrs[i];
+      st->xinv[m] = _gfshare_ecc_inv(ctx->sharenrs[i]);
+      m++;
+    }
+  }
+  for(i = 0; i < m; i++) {
+    st->v[i] = 1;
+    for(l = 0; l < m; l++) {
+      if(l != i) {
+        st->v[i] = gfshare_gf_mul(st->v[i], st->x[i] ^ st->x[l]);
+      }
+    }
+    st->v[i] = _gfshare_ecc_inv(st->v[i]);
+  }
+
+  if(_gfshare_ecc_scan(ctx, st, found) == 0) {
+    for(i = 0; i < ctx->sharecount; i++) {
+      if(found[i]) {
+        st->tmp[i] = 0;
+        dropped++;
+      } else {
+        st->tmp[i] = ctx->sharenrs[i];
+      }
+    }
+    if(m - dropped >= ctx->threshold) {
+      if(dropped) {
+        gfshare_ctx_dec_newshares(ctx, st->tmp);
+      }
+      gfshare_ctx_dec_extract(ctx, secretbuf);
+      if(dropped) {
+        gfshare_ctx_dec_newshares(ctx, st->sharenrs);
+      }
+      ret = 0;
+    }
+  }
+
+  if(bad != NULL) {
+    memcpy(bad, found, ctx->sharecount);
+  }
+  kfree(st);
+  return ret;
+}
@@ -0,0 +1,422 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* GF(256) multiply kernels used by the split and combine loops.
+ *
+ * The vector engines use the split-nibble method: for a fixed multiplier c,
+ * c*x == c*(x & 0x0f) ^ c*(x & 0xf0), and each half is a 16 entry table
+ * lookup which PSHUFB does for 16 (SSSE3) or 32 (AVX2) bytes at once.
+ * The bitsliced engine lives in libgfshare_bitslice.c. Every engine that
+ * passes its self-test here can be picked per context by name.
+ */
+
+#include "libgfshare_internal.h"
+#include "libgfshare_tables.h"
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/string.h>
+
+#ifdef CONFIG_X86_64
+#include <asm/cpufeature.h>
+#include <asm/fpu/api.h>
+#include <asm/simd.h>
+#endif
+
+static char *gf_engine = "auto";
+module_param(gf_engine, charp, 0444);
+MODULE_PARM_DESC(gf_engine, "Default GF(256) engine: auto, scalar, ssse3, avx2 or bitslice");
+
+uint8_t gfshare_gf_mul(uint8_t a, uint8_t b)
+{
+  if(a == 0 || b == 0) {
+    return 0;
+  }
+  return exps[logs[a] + logs[b]];
+}
+
+static void _gfshare_mul_xor_scalar(uint8_t* out, const uint8_t* a,
+                                    const uint8_t* b, uint8_t c, size_t len)
+{
+  uint32_t ilog = logs[c];
+  size_t pos;
+
+  if(c == 0) {
+    memmove(out, b, len);
+    return;
+  }
+
+  for(pos = 0; pos < len; ++pos) {
+    uint8_t byte = a[pos];
+    if(byte) {
+      byte = exps[ilog + logs[byte]];
+    }
+    out[pos] = byte ^ b[pos];
+  }
+}
+
+/* Fill row[x] = c * x for every x */
+void gfshare_gf_row(uint8_t c, uint8_t row[256])
+{
+  int x;
+
+  for(x = 0; x < 256; x++) {
+    row[x] = gfshare_gf_mul(c, x);
+  }
+}
+
+/* tbl[0..15] = c*i, tbl[16..31] = c*(i<<4) */
+void gfshare_gf_nibbles(uint8_t c, uint8_t tbl[32])
+{
+  int i;
+
+  for(i = 0; i < 16; i++) {
+    tbl[i] = gfshare_gf_mul(c, i);
+    tbl[16 + i] = gfshare_gf_mul(c, i << 4);
+  }
+}
+
+static void _gfshare_mul_xor_row_scalar(uint8_t* out, const uint8_t* a,
+                                        const uint8_t* b, const uint8_t* row,
+                                        size_t len)
+{
+  size_t pos;
+
+  for(pos = 0; pos < len; ++pos) {
+    out[pos] = row[a[pos]] ^ b[pos];
+  }
+}
+
+const struct gfshare_gf_ops gfshare_gf_scalar = {
+  .name = "scalar",
+  .mul_xor = _gfshare_mul_xor_scalar,
+  .mul_xor_row = _gfshare_mul_xor_row_scalar,
+  .spec = gfshare_spec_scalar,
+};
+
+const struct gfshare_gf_ops* gfshare_gf = &gfshare_gf_scalar;
+
+#ifdef CONFIG_X86_64
+
+/* Bytes processed per kernel_fpu_begin() section, so that huge secrets do
+ * not hold preemption off for the whole call.
+ */
+#define GFSHARE_FPU_CHUNK 4096
+
+static const uint8_t gfshare_nibble_mask[16] __aligned(16) = {
+  0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+  0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f };
+
+/* The same tables, picked out of a precomputed multiply row */
+static void _gfshare_nibble_tables_row(const uint8_t* row, uint8_t tbl[32])
+{
+  int i;
+
+  for(i = 0; i < 16; i++) {
+    tbl[i] = row[i];
+    tbl[16 + i] = row[i << 4];
+  }
+}
+
+/* len must be a non-zero multiple of 16 */
+static void _gfshare_mul_xor_ssse3_blocks(uint8_t* out, const uint8_t* a,
+                                          const uint8_t* b, const uint8_t* tbl,
+                                          size_t len)
+{
+  size_t i = 0;
+
+  asm volatile(
+    "movdqu  %[lo], %%xmm6\n\t"
+    "movdqu  %[hi], %%xmm5\n\t"
+    "movdqu  %[mask], %%xmm7\n\t"
+    "1:\n\t"
+    "movdqu  (%[a],%[i]), %%xmm0\n\t"
+    "movdqa  %%xmm0, %%xmm1\n\t"
+    "psrlw   $4, %%xmm1\n\t"
+    "pand    %%xmm7, %%xmm0\n\t"
+    "pand    %%xmm7, %%xmm1\n\t"
+    "movdqa  %%xmm6, %%xmm2\n\t"
+    "movdqa  %%xmm5, %%xmm3\n\t"
+    "pshufb  %%xmm0, %%xmm2\n\t"
+    "pshufb  %%xmm1, %%xmm3\n\t"
+    "pxor    %%xmm3, %%xmm2\n\t"
+    "movdqu  (%[b],%[i]), %%xmm4\n\t"
+    "pxor    %%xmm4, %%xmm2\n\t"
+    "movdqu  %%xmm2, (%[out],%[i])\n\t"
+    "add     $16, %[i]\n\t"
+    "cmp     %[len], %[i]\n\t"
+    "jb      1b\n\t"
+    : [i] "+r" (i)
+    : [out] "r" (out), [a] "r" (a), [b] "r" (b), [len] "r" (len),
+      [lo] "m" (*(const uint8_t (*)[16])tbl),
+      [hi] "m" (*(const uint8_t (*)[16])(tbl + 16)),
+      [mask] "m" (gfshare_nibble_mask)
+    : "memory", "cc");
+}
+
+/* len must be a non-zero multiple of 32 */
+static void _gfshare_mul_xor_avx2_blocks(uint8_t* out, const uint8_t* a,
+                                         const uint8_t* b, const uint8_t* tbl,
+                                         size_t len)
+{
+  size_t i = 0;
+
+  asm volatile(
+    "vbroadcasti128 %[lo], %%ymm6\n\t"
+    "vbroadcasti128 %[hi], %%ymm5\n\t"
+    "vbroadcasti128 %[mask], %%ymm7\n\t"
+    "1:\n\t"
+    "vmovdqu (%[a],%[i]), %%ymm0\n\t"
+    "vpsrlw  $4, %%ymm0, %%ymm1\n\t"
+    "vpand   %%ymm7, %%ymm0, %%ymm0\n\t"
+    "vpand   %%ymm7, %%ymm1, %%ymm1\n\t"
+    "vpshufb %%ymm0, %%ymm6, %%ymm0\n\t"
+    "vpshufb %%ymm1, %%ymm5, %%ymm1\n\t"
+    "vpxor   %%ymm1, %%ymm0, %%ymm0\n\t"
+    "vpxor   (%[b],%[i]), %%ymm0, %%ymm0\n\t"
+    "vmovdqu %%ymm0, (%[out],%[i])\n\t"
+    "add     $32, %[i]\n\t"
+    "cmp     %[len], %[i]\n\t"
+    "jb      1b\n\t"
+    "vzeroupper\n\t"
+    : [i] "+r" (i)
+    : [out] "r" (out), [a] "r" (a), [b] "r" (b), [len] "r" (len),
+      [lo] "m" (*(const uint8_t (*)[16])tbl),
+      [hi] "m" (*(const uint8_t (*)[16])(tbl + 16)),
+      [mask] "m" (gfshare_nibble_mask)
+    : "memory", "cc");
+}
+
+typedef void (*_gfshare_blocks_t)(uint8_t*, const uint8_t*, const uint8_t*,
+                                  const uint8_t*, size_t);
+
+/* Run 'blocks' over the largest multiple of 'width' bytes inside FPU
+ * sections of at most GFSHARE_FPU_CHUNK bytes and return how many bytes
+ * were done. The caller finishes the tail with the scalar engine.
+ */
+static size_t _gfshare_simd_run(_gfshare_blocks_t blocks, size_t width,
+                                uint8_t* out, const uint8_t* a,
+                                const uint8_t* b, const uint8_t* tbl,
+                                size_t len)
+{
+  size_t chunk, done = 0;
+
+  while(len - done >= width) {
+    chunk = min_t(size_t, len - done, GFSHARE_FPU_CHUNK) & ~(width - 1);
+    kernel_fpu_begin();
+    blocks(out + done, a + done, b + done, tbl, chunk);
+    kernel_fpu_end();
+    done += chunk;
+  }
+  return done;
+}
+
+static void _gfshare_mul_xor_simd(_gfshare_blocks_t blocks, size_t width,
+                                  uint8_t* out, const uint8_t* a,
+                                  const uint8_t* b, uint8_t c, size_t len)
+{
+  uint8_t tbl[32];
+  size_t done;
+
+  if(len < width || !may_use_simd()) {
+    _gfshare_mul_xor_scalar(out, a, b, c, len);
+    return;
+  }
+
+  gfshare_gf_nibbles(c, tbl);
+  done = _gfshare_simd_run(blocks, width, out, a, b, tbl, len);
+  _gfshare_mul_xor_scalar(out + done, a + done, b + done, c, len - done);
+}
+
+static void _gfshare_mul_xor_row_simd(_gfshare_blocks_t blocks, size_t width,
+                                      uint8_t* out, const uint8_t* a,
+                                      const uint8_t* b, const uint8_t* row,
+                                      size_t len)
+{
+  uint8_t tbl[32];
+  size_t done;
+
+  if(len < width || !may_use_simd()) {
+    _gfshare_mul_xor_row_scalar(out, a, b, row, len);
+    return;
+  }
+
+  _gfshare_nibble_tables_row(row, tbl);
+  done = _gfshare_simd_run(blocks, width, out, a, b, tbl, len);
+  _gfshare_mul_xor_row_scalar(out + done, a + done, b + done, row,
+                              len - done);
+}
+
+static void _gfshare_mul_xor_ssse3(uint8_t* out, const uint8_t* a,
+                                   const uint8_t* b, uint8_t c, size_t len)
+{
+  _gfshare_mul_xor_simd(_gfshare_mul_xor_ssse3_blocks, 16, out, a, b, c, len);
+}
+
+static void _gfshare_mul_xor_row_ssse3(uint8_t* out, const uint8_t* a,
+                                       const uint8_t* b, const uint8_t* row,
+                                       size_t len)
+{
+  _gfshare_mul_xor_row_simd(_gfshare_mul_xor_ssse3_blocks, 16,
+                            out, a, b, row, len);
+}
+
+static void _gfshare_mul_xor_avx2(uint8_t* out, const uint8_t* a,
+                                  const uint8_t* b, uint8_t c, size_t len)
+{
+  _gfshare_mul_xor_simd(_gfshare_mul_xor_avx2_blocks, 32, out, a, b, c, len);
+}
+
+static void _gfshare_mul_xor_row_avx2(uint8_t* out, const uint8_t* a,
+                                      const uint8_t* b, const uint8_t* row,
+                                      size_t len)
+{
+  _gfshare_mul_xor_row_simd(_gfshare_mul_xor_avx2_blocks, 32,
+                            out, a, b, row, len);
+}
+
+static const struct gfshare_gf_ops gfshare_gf_ssse3 = {
+  .name = "ssse3",
+  .mul_xor = _gfshare_mul_xor_ssse3,
+  .mul_xor_row = _gfshare_mul_xor_row_ssse3,
+};
+
+static const struct gfshare_gf_ops gfshare_gf_avx2 = {
+  .name = "avx2",
+  .mul_xor = _gfshare_mul_xor_avx2,
+  .mul_xor_row = _gfshare_mul_xor_row_avx2,
+  .spec = gfshare_spec_avx2,
+};
+
+#endif /* CONFIG_X86_64 */
+
+#define GFSHARE_SELFTEST_LEN 103 /* 3 AVX2 blocks, 2 SSE blocks and a tail */
+
+/* Check an engine against the scalar reference, both in place (as the
+ * encoder and decoder call it) and out of place.
+ */
+static int _gfshare_gf_selftest(const struct gfshare_gf_ops* ops)
+{
+  uint8_t a[GFSHARE_SELFTEST_LEN], b[GFSHARE_SELFTEST_LEN];
+  uint8_t want[GFSHARE_SELFTEST_LEN], got[GFSHARE_SELFTEST_LEN];
+  uint8_t row[256];
+  static const uint8_t cs[] = { 0x00, 0x01, 0x02, 0x53, 0x8e, 0xff };
+  int i, n;
+
+  for(i = 0; i < GFSHARE_SELFTEST_LEN; i++) {
+    a[i] = i * 167 + 13;
+    b[i] = i * 59 + 101;
+  }
+
+  for(n = 0; n < ARRAY_SIZE(cs); n++) {
+    _gfshare_mul_xor_scalar(want, a, b, cs[n], GFSHARE_SELFTEST_LEN);
+    ops->mul_xor(got, a, b, cs[n], GFSHARE_SELFTEST_LEN);
+    if(memcmp(want, got, GFSHARE_SELFTEST_LEN)) {
+      return 1;
+    }
+    memcpy(got, a, GFSHARE_SELFTEST_LEN);
+    ops->mul_xor(got, got, b, cs[n], GFSHARE_SELFTEST_LEN);
+    if(memcmp(want, got, GFSHARE_SELFTEST_LEN)) {
+      return 1;
+    }
+    gfshare_gf_row(cs[n], row);
+    ops->mul_xor_row(got, a, b, row, GFSHARE_SELFTEST_LEN);
+    if(memcmp(want, got, GFSHARE_SELFTEST_LEN)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* AVX2 present and its register state enabled by the kernel */
+int gfshare_cpu_has_avx2(void)
+{
+#ifdef CONFIG_X86_64
+  return boot_cpu_has(X86_FEATURE_AVX2) && boot_cpu_has(X86_FEATURE_AVX) &&
+         cpu_has_xfeatures(XFEATURE_MASK_SSE | XFEATURE_MASK_YMM, NULL);
+#else
+  return 0;
+#endif
+}
+
+/* Engines this CPU can run that passed their self-test, scalar first */
+static const struct gfshare_gf_ops* gfshare_gf_engines[4];
+static int gfshare_gf_nengines;
+
+static void _gfshare_gf_add(const struct gfshare_gf_ops* ops)
+{
+  if(ops != &gfshare_gf_scalar && _gfshare_gf_selftest(ops)) {
+    printk(KERN_WARNING "gfshare: %s engine failed self-test\n", ops->name);
+    return;
+  }
+  gfshare_gf_engines[gfshare_gf_nengines++] = ops;
+}
+
+/* Look up a usable engine by name */
+const struct gfshare_gf_ops* gfshare_gf_find(const char* name)
+{
+  int i;
+
+  for(i = 0; i < gfshare_gf_nengines; i++) {
+    if(!strcmp(gfshare_gf_engines[i]->name, name)) {
+      return gfshare_gf_engines[i];
+    }
+  }
+  return NULL;
+}
+
+/* Select the fastest engine the CPU supports, or the one gf_engine names */
+void gfshare_gf_init(void)
+{
+  const struct gfshare_gf_ops* best = &gfshare_gf_scalar;
+
+  gfshare_gf_nengines = 0;
+  _gfshare_gf_add(&gfshare_gf_scalar);
+  _gfshare_gf_add(&gfshare_gf_bitslice);
+#ifdef CONFIG_X86_64
+  if(boot_cpu_has(X86_FEATURE_SSSE3)) {
+    _gfshare_gf_add(&gfshare_gf_ssse3);
+  }
+  if(gfshare_cpu_has_avx2()) {
+    _gfshare_gf_add(&gfshare_gf_avx2);
+  }
+#endif
+
+  /* Bitslice is opt-in: the fastest vector engine that passed, else scalar */
+  if(gfshare_gf_engines[gfshare_gf_nengines - 1] != &gfshare_gf_bitslice) {
+    best = gfshare_gf_engines[gfshare_gf_nengines - 1];
+  }
+  if(strcmp(gf_engine, "auto")) {
+    if(gfshare_gf_find(gf_engine)) {
+      best = gfshare_gf_find(gf_engine);
+    } else {
+      printk(KERN_WARNING "gfshare: no GF(256) engine '%s', using %s\n",
+             gf_engine, best->name);
+    }
+  }
+
+  gfshare_gf = best;
+  printk(KERN_INFO "gfshare: using %s GF(256) engine\n", best->name);
+}
@@ -0,0 +1,180 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Hybrid contexts ("secret sharing made short"): for secrets of
+ * GFSHARE_HYBRID_MIN bytes or more, the secret is encrypted with Speck-CTR
+ * under a fresh 16 byte key, the ciphertext is dispersed k-of-n, and only
+ * the key is Shamir shared. A share is the 16 byte key share followed by
+ * ceil(size / k) bytes of ciphertext, where plain Shamir shares are 'size'
+ * bytes. Shorter secrets are shared as usual.
+ *
+ * Both halves are one degree k-1 polynomial. The encoder's buffer holds k
+ * rows of 16 + m bytes, from the top degree down. Row r is 16 random bytes
+ * (the key itself in the last row, the constant term) followed by
+ * ciphertext piece r. Evaluating the rows at each x gives Shamir shares of
+ * the key and a dispersal of the ciphertext in a single pass. The
+ * recombiner interpolates P(0) over the first 16 bytes and the whole
+ * polynomial over the rest. Piece r is encrypted from counter
+ * r * ceil(m / 16), so no two pieces share a block of keystream.
+ */
+
+#include "libgfshare_internal.h"
+
+#include <linux/kernel.h>
+#include <linux/random.h>
+#include <linux/string.h>
+
+/* Keystream is made this many bytes at a time, a whole number of blocks */
+#define GFSHARE_HYBRID_CHUNK 512
+
+/* Initialise a hybrid context for producing shares */
+gfshare_ctx* gfshare_ctx_init_enc_hybrid(const uint8_t* sharenrs,
+                                         uint32_t sharecount,
+                                         uint32_t threshold,
+                                         size_t maxsize)
+{
+  gfshare_ctx* ctx;
+
+  if(threshold < 2) {
+    return NULL;
+  }
+  ctx = gfshare_ctx_init_enc(sharenrs, sharecount, threshold, maxsize);
+  if(ctx != NULL) {
+    ctx->hybrid = 1;
+  }
+  return ctx;
+}
+
+/* Initialise a hybrid context for recombining shares */
+gfshare_ctx* gfshare_ctx_init_dec_hybrid(const uint8_t* sharenrs,
+                                         uint32_t sharecount,
+                                         uint32_t threshold,
+                                         size_t maxsize)
+{
+  gfshare_ctx* ctx;
+
+  if(threshold < 2) {
+    return NULL;
+  }
+  ctx = gfshare_ctx_init_dec(sharenrs, sharecount, threshold, maxsize);
+  if(ctx != NULL) {
+    ctx->hybrid = 1;
+  }
+  return ctx;
+}
+
+/* XOR piece r's keystream, from byte 'col' of the piece on, into buf */
+static void _gfshare_hybrid_crypt(const struct gfshare_speck_ctx* key,
+                                  size_t m, uint32_t r, size_t col,
+                                  uint8_t* buf, size_t len)
+{
+  uint8_t ks[GFSHARE_HYBRID_CHUNK];
+  uint64_t ctr[2] = { r * DIV_ROUND_UP(m, 16) + col / 16, 0 };
+  size_t skip = col % 16, pos, n, i;
+
+  for(pos = 0; pos < len; pos += n) {
+    n = min_t(size_t, len - pos, sizeof(ks) - skip);
+    gfshare_speck_ctr(key, ctr, ks, skip + n);
+    for(i = 0; i < n; i++) {
+      buf[pos + i] ^= ks[skip + i];
+    }
+    skip = 0;
+  }
+  memzero_explicit(ks, sizeof(ks));
+}
+
+/* Split a secret of GFSHARE_HYBRID_MIN bytes or more */
+void _gfshare_hybrid_getshares(const gfshare_ctx* ctx, const uint8_t* secret,
+                               uint8_t** shares)
+{
+  size_t m = DIV_ROUND_UP(ctx->size, ctx->threshold);
+  size_t stride = GFSHARE_HYBRID_KEY + m, len;
+  struct gfshare_speck_ctx key;
+  uint8_t* row;
+  uint32_t r;
+
+  for(r = 0; r < ctx->threshold - 1; r++) {
+    _gfshare_ctx_fill_rand(ctx, ctx->buffer + r * stride, GFSHARE_HYBRID_KEY);
+  }
+  row = ctx->buffer + (ctx->threshold - 1) * stride;
+  get_random_bytes(row, GFSHARE_HYBRID_KEY);
+  gfshare_speck_setkey(&key, row);
+
+  for(r = 0; r < ctx->threshold; r++) {
+    row = ctx->buffer + r * stride + GFSHARE_HYBRID_KEY;
+    len = r * m < ctx->size ? min_t(size_t, m, ctx->size - r * m) : 0;
+    memcpy(row, secret + r * m, len);
+    memset(row + len, 0, m - len);
+    _gfshare_hybrid_crypt(&key, m, r, 0, row, len);
+  }
+  memzero_explicit(&key, sizeof(key));
+
+  _gfshare_enc_eval(ctx, ctx->buffer, stride,
+                    ctx->buffer + (ctx->threshold - 1) * stride, shares,
+                    0, stride);
+}
+
+/* Recover the key and bytes [start, start + count) of the ciphertext,
+ * then decrypt them in place
+ */
+void _gfshare_hybrid_extract_range(const gfshare_ctx* ctx, uint8_t* out,
+                                   size_t start, size_t count)
+{
+  const struct gfshare_dec_plan* plan = ctx->plan;
+  size_t m = DIV_ROUND_UP(ctx->size, ctx->threshold), from, to;
+  uint8_t q[256], basis[256], k[GFSHARE_HYBRID_KEY];
+  struct gfshare_speck_ctx key;
+  const uint8_t* share;
+  uint64_t t0 = gfshare_stat_begin();
+  uint32_t n, r;
+
+  memset(k, 0, sizeof(k));
+  memset(out, 0, count);
+  _gfshare_ramp_product(ctx, q);
+  for(n = 0; n < plan->count; n++) {
+    _gfshare_ramp_basis(ctx, q, n, basis);
+    share = ctx->buffer + ctx->maxsize * plan->index[n];
+    ctx->gf->mul_xor(k, share, k, basis[0], sizeof(k));
+    share += GFSHARE_HYBRID_KEY;
+    for(r = start / m; r < ctx->threshold && r * m < start + count; r++) {
+      from = max_t(size_t, start, r * m);
+      to = min_t(size_t, start + count, (r + 1) * m);
+      ctx->gf->mul_xor(out + (from - start), share + from - r * m,
+                       out + (from - start), basis[ctx->threshold - 1 - r],
+                       to - from);
+    }
+  }
+  gfshare_stat_end(GFSHARE_STAT_DEC_INTERP, t0, count);
+
+  gfshare_speck_setkey(&key, k);
+  for(r = start / m; r < ctx->threshold && r * m < start + count; r++) {
+    from = max_t(size_t, start, r * m);
+    to = min_t(size_t, start + count, (r + 1) * m);
+    _gfshare_hybrid_crypt(&key, m, r, from - r * m, out + (from - start),
+                          to - from);
+  }
+  memzero_explicit(k, sizeof(k));
+  memzero_explicit(&key, sizeof(key));
+}
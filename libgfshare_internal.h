@@ -0,0 +1,430 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Definitions shared between the libgfshare translation units. Nothing in
+ * here is part of the public interface in libgfshare.h.
+ */
+
+#ifndef LIBGFSHARE_INTERNAL_H
+#define LIBGFSHARE_INTERNAL_H
+
+#include "libgfshare.h"
+
+#include <linux/jump_label.h>
+#include <linux/timekeeping.h>
+
+/* Number of share-index sets a decode context remembers plans for */
+#define GFSHARE_PLAN_CACHE 4
+
+/* Everything gfshare_ctx_dec_extract needs that depends only on which
+ * shares are present: the buffer slots to interpolate from and each one's
+ * Lagrange weight L(i), kept as a multiply row. Built by
+ * gfshare_ctx_dec_newshares and cached by share-index set.
+ */
+struct gfshare_dec_plan {
+  uint64_t last_used;   /* 0 for an unused cache slot */
+  uint32_t count;       /* number of shares interpolated, <= threshold */
+  uint8_t* sharenrs;    /* the sharenrs this plan was built for */
+  uint32_t* index;      /* [count] slots in ctx->buffer */
+  uint8_t (*rows)[256]; /* [count] rows[n][x] = L(index[n]) * x */
+  uint8_t (*nibbles)[32]; /* [count] the same as split-nibble tables */
+};
+
+/* ------------------------------------------------[ Specialised (k,n) ]---- */
+
+/* (threshold, sharecount) pairs that get fully unrolled split and combine
+ * kernels. Add pairs here; sharecount may not exceed GFSHARE_SPEC_MAX_SHARES
+ * and threshold must be at least 2.
+ */
+#define GFSHARE_SPEC_CONFIGS(X) \
+  X(2, 3)                       \
+  X(3, 5)                       \
+  X(4, 6)
+
+#define GFSHARE_SPEC_MAX_SHARES 8
+
+/* Bytes [start, start + count) of every share, as _gfshare_enc_eval, with
+ * the multiplier of share j given by its nibble tables tbl[j].
+ */
+typedef void (*gfshare_spec_enc_t)(uint8_t** shares, const uint8_t* coeffs,
+                                   size_t stride, const uint8_t* secret,
+                                   const uint8_t (*tbl)[32],
+                                   uint32_t start, uint32_t count);
+
+/* out[i] = sum over the threshold shares of L(n) * in[n][i] */
+typedef void (*gfshare_spec_dec_t)(uint8_t* out, const uint8_t* const* in,
+                                   const uint8_t (*tbl)[32], size_t len);
+
+struct gfshare_spec {
+  uint32_t threshold;
+  uint32_t sharecount;
+  gfshare_spec_enc_t enc;
+  gfshare_spec_dec_t dec;
+};
+
+/* Zero-terminated kernel tables, one per engine that has them */
+extern const struct gfshare_spec gfshare_spec_scalar[];
+extern const struct gfshare_spec gfshare_spec_avx2[];
+
+/* Kernels for a context, NULL if this pair isn't specialised. The split
+ * kernel needs the exact pair; the combine kernel depends on threshold only.
+ */
+gfshare_spec_enc_t gfshare_spec_find_enc(uint32_t threshold, uint32_t sharecount);
+gfshare_spec_dec_t gfshare_spec_find_dec(uint32_t threshold);
+
+/* Check the current engine's kernels and enable them */
+void gfshare_spec_init(void);
+
+/* GF(2^16) product, bit by bit; for setup, not data */
+uint16_t gfshare16_mul(uint16_t a, uint16_t b);
+
+/* Enable the AVX2 GF(2^16) kernel if the CPU has it and it checks out */
+void gfshare16_init(void);
+
+/* Keystream of a streamed split, carried from chunk to chunk */
+struct gfshare_enc_stream;
+
+struct _gfshare_ctx {
+  uint32_t sharecount;
+  uint32_t threshold;
+  uint32_t maxsize;
+  uint32_t size;
+  /* Secret pieces per share: 1, or threshold - privacy for a ramp context */
+  uint32_t chunks;
+  /* Encrypt, disperse and share the key for secrets of GFSHARE_HYBRID_MIN
+   * bytes or more
+   */
+  int hybrid;
+  uint8_t* sharenrs;
+  uint8_t* buffer;       /* NULL for a borrowed-share decoder */
+  uint32_t buffersize;
+  /* Recombination only: recently used decode plans and the current one */
+  struct gfshare_dec_plan* plans;
+  struct gfshare_dec_plan* plan;
+  uint64_t plan_clock;
+  /* Borrowed-share recombination only: [sharecount] the caller's shares */
+  const uint8_t** borrowed;
+  /* Coefficient generator for this context, NULL for gfshare_fill_rand */
+  struct gfshare_rand_backend* rand;
+  /* The caller may sleep in every call on this context, so large secrets
+   * can be split or recombined across CPUs (gfshare_ctx_set_parallel)
+   */
+  int parallel;
+  /* Splitting only: the stream between enc_stream_init and _final */
+  struct gfshare_enc_stream* stream;
+  /* Size class of a pooled context, NULL if it was kmalloc'd */
+  struct gfshare_ctx_class* pool;
+  /* GF(256) engine for this context, gfshare_gf unless set otherwise */
+  const struct gfshare_gf_ops* gf;
+  /* Kernels specialised for this threshold and sharecount, or NULL. Only
+   * used with the default engine, which they are built on.
+   */
+  gfshare_spec_enc_t enc_kernel;
+  gfshare_spec_dec_t dec_kernel;
+  /* Splitting with enc_kernel: nibble tables of each sharenr */
+  uint8_t enc_tbl[GFSHARE_SPEC_MAX_SHARES][32];
+};
+
+/* Where share 'sharenr' of the current secret lives */
+static inline const uint8_t* _gfshare_dec_share(const gfshare_ctx* ctx,
+                                                uint32_t sharenr)
+{
+  if(ctx->borrowed != NULL) {
+    return ctx->borrowed[sharenr];
+  }
+  return ctx->buffer + ctx->maxsize * sharenr;
+}
+
+/* Made for splitting; only recombination contexts have decode plans */
+static inline int _gfshare_ctx_enc(const gfshare_ctx* ctx)
+{
+  return ctx->plans == NULL;
+}
+
+/* Whole-size Shamir shares: neither a ramp nor a hybrid context */
+static inline int _gfshare_ctx_plain(const gfshare_ctx* ctx)
+{
+  return ctx->chunks == 1 && !ctx->hybrid;
+}
+
+/* Hybrid contexts take the short path for secrets this long or longer.
+ * Below it the 16 byte key share eats most of the saving, and above it a
+ * share always fits in the 'maxsize' bytes a plain share would take.
+ */
+#define GFSHARE_HYBRID_MIN 64
+#define GFSHARE_HYBRID_KEY 16
+
+static inline int _gfshare_ctx_hybrid(const gfshare_ctx* ctx)
+{
+  return ctx->hybrid && ctx->size >= GFSHARE_HYBRID_MIN;
+}
+
+/* ---------------------------------------------------------[ Library ]---- */
+
+/* Contexts laid out in a single caller-provided block, for the context pool.
+ * _gfshare_ctx_footprint is 0 for invalid parameters.
+ */
+size_t _gfshare_ctx_footprint(const uint8_t* sharenrs, uint32_t sharecount,
+                              uint32_t threshold, size_t maxsize, int dec);
+gfshare_ctx* _gfshare_ctx_carve(void* mem, const uint8_t* sharenrs,
+                                uint32_t sharecount, uint32_t threshold,
+                                size_t maxsize, int dec);
+void _gfshare_ctx_wipe(gfshare_ctx* ctx);
+
+int gfshare_ctx_pool_init(void);
+void gfshare_ctx_pool_exit(void);
+
+/* Fill 'count' random bytes, with the context's own backend if it has one */
+void _gfshare_ctx_fill_rand(const gfshare_ctx* ctx, uint8_t* buffer, size_t count);
+/* The same with backend 'rand', or gfshare_fill_rand if it is NULL */
+void _gfshare_fill_rand_with(struct gfshare_rand_backend* rand,
+                             uint8_t* buffer, size_t count);
+
+/* Produce bytes [start, start + count) of every share. Coefficient c of the
+ * random part is at coeffs + c * stride; the constant term is 'secret'.
+ */
+void _gfshare_enc_eval(const gfshare_ctx* ctx,
+                       const uint8_t* coeffs, size_t stride,
+                       const uint8_t* secret, uint8_t** shares,
+                       uint32_t start, uint32_t count);
+
+/* Interpolate bytes [start, start + count) of the secret from the
+ * context's shares into out[0, count)
+ */
+void _gfshare_dec_extract_range(const gfshare_ctx* ctx, uint8_t* out,
+                                uint32_t start, uint32_t count);
+
+/* Ramp contexts, libgfshare_ramp.c */
+void _gfshare_ramp_getshares(const gfshare_ctx* ctx, const uint8_t* secret,
+                             uint8_t** shares);
+void _gfshare_ramp_extract_range(const gfshare_ctx* ctx, uint8_t* out,
+                                 size_t start, size_t count);
+
+/* Lagrange basis over the shares in the current plan: q is the product of
+ * (x + x_j), and basis[d] the x^d coefficient of the n'th basis polynomial
+ */
+void _gfshare_ramp_product(const gfshare_ctx* ctx, uint8_t q[256]);
+void _gfshare_ramp_basis(const gfshare_ctx* ctx, const uint8_t q[256],
+                         uint32_t n, uint8_t basis[256]);
+
+/* Hybrid contexts, libgfshare_hybrid.c */
+void _gfshare_hybrid_getshares(const gfshare_ctx* ctx, const uint8_t* secret,
+                               uint8_t** shares);
+void _gfshare_hybrid_extract_range(const gfshare_ctx* ctx, uint8_t* out,
+                                   size_t start, size_t count);
+
+/* Split or recombine across CPUs. Return 1, having done nothing, when the
+ * secret is below the parallel threshold or the context isn't marked
+ * parallel.
+ */
+int _gfshare_par_getshares(const gfshare_ctx* ctx, const uint8_t* secret,
+                           uint8_t** shares);
+int _gfshare_par_extract(const gfshare_ctx* ctx, uint8_t* secretbuf);
+
+/* Whether the split and combine above would run across CPUs */
+int _gfshare_par_wanted(const gfshare_ctx* ctx);
+
+int _gfshare_par_init(void);
+void _gfshare_par_exit(void);
+
+/* Job queue for gfshare_job_submit, libgfshare_async.c */
+int gfshare_async_init(void);
+void gfshare_async_exit(void);
+
+/* ---------------------------------------------------[ GF(256) engines ]---- */
+
+/* out[i] = c * a[i] ^ b[i] for 0 <= i < len.
+ * out may alias a or b, so the same routine serves as the Horner step of the
+ * encoder (out = a = share, b = coefficient) and as the multiply-accumulate
+ * of the decoder (out = b = secret, a = share).
+ */
+typedef void (*gfshare_mul_xor_t)(uint8_t* out, const uint8_t* a,
+                                  const uint8_t* b, uint8_t c, size_t len);
+
+/* As gfshare_mul_xor_t, with c given as its multiply row (row[x] = c * x) */
+typedef void (*gfshare_mul_xor_row_t)(uint8_t* out, const uint8_t* a,
+                                      const uint8_t* b, const uint8_t* row,
+                                      size_t len);
+
+struct gfshare_spec;
+
+struct gfshare_gf_ops {
+  const char* name;
+  gfshare_mul_xor_t mul_xor;
+  gfshare_mul_xor_row_t mul_xor_row;
+  /* Specialised kernels built on this engine, or NULL */
+  const struct gfshare_spec* spec;
+};
+
+/* The engine picked by gfshare_gf_init(), never NULL */
+extern const struct gfshare_gf_ops* gfshare_gf;
+
+/* The table-driven byte-at-a-time engine. Always available, and the
+ * reference the vector engines are checked against.
+ */
+extern const struct gfshare_gf_ops gfshare_gf_scalar;
+
+/* Bitsliced, 64 bytes at a time: no tables and no branches on the data, so
+ * its timing doesn't depend on the secret. libgfshare_bitslice.c
+ */
+extern const struct gfshare_gf_ops gfshare_gf_bitslice;
+
+/* An engine usable on this CPU by name ("scalar", "bitslice", "ssse3",
+ * "avx2"), or NULL
+ */
+const struct gfshare_gf_ops* gfshare_gf_find(const char* name);
+
+/* Multiply two field elements */
+uint8_t gfshare_gf_mul(uint8_t a, uint8_t b);
+
+/* Fill row[x] = c * x for every x */
+void gfshare_gf_row(uint8_t c, uint8_t row[256]);
+
+/* Fill the split-nibble tables of c: tbl[i] = c*i, tbl[16+i] = c*(i<<4) */
+void gfshare_gf_nibbles(uint8_t c, uint8_t tbl[32]);
+
+/* Select the default engine, the fastest the CPU supports unless the
+ * gf_engine parameter names another
+ */
+void gfshare_gf_init(void);
+
+/* AVX2 present and its register state enabled by the kernel */
+int gfshare_cpu_has_avx2(void);
+
+/* ------------------------------------------------------[ Speck-CTR ]---- */
+
+#define SPECK_ROUNDS 32
+
+/* Speck-128/128 with its round keys expanded once per key */
+struct gfshare_speck_ctx {
+  uint64_t rk[SPECK_ROUNDS];
+};
+
+void gfshare_speck_setkey(struct gfshare_speck_ctx* ctx, const uint8_t key[16]);
+
+void gfshare_speck_encrypt(const struct gfshare_speck_ctx* ctx,
+                           uint64_t ct[2], uint64_t const pt[2]);
+
+/* Write 'len' bytes of keystream from 128 bit block counter 'ctr' (low word
+ * first) and leave ctr at the next unused block. Any length is allowed.
+ */
+void gfshare_speck_ctr(const struct gfshare_speck_ctx* ctx, uint64_t ctr[2],
+                       uint8_t* out, size_t len);
+
+/* One-shot keystream from a zero counter under a 16 byte seed */
+void generate_block_ctr(size_t output_length, uint8_t* output_block,
+                        uint8_t* seed);
+
+struct gfshare_enc_stream {
+  struct gfshare_speck_ctx key;
+  uint64_t ctr[2];
+};
+
+/* Select the multi-lane implementation the CPU supports */
+void gfshare_speck_init(void);
+
+/* ------------------------------------------------[ Random backends ]---- */
+
+struct gfshare_rand_backend {
+  const char* name;
+  int (*init)(struct gfshare_rand_backend* be);   /* optional */
+  void (*exit)(struct gfshare_rand_backend* be);  /* optional */
+  /* Fill buffer with fresh keystream; callable from any context */
+  void (*generate)(struct gfshare_rand_backend* be, uint8_t* buffer,
+                   size_t count);
+  void* priv;
+  bool available;
+  uint64_t mbps;  /* measured at load */
+};
+
+/* The module-wide backend: the fastest, or the one named by rand_backend */
+extern struct gfshare_rand_backend* gfshare_rand;
+
+/* Look up an available backend by name, NULL if there isn't one */
+struct gfshare_rand_backend* gfshare_rand_find(const char* name);
+
+int gfshare_rand_init(void);
+void gfshare_rand_exit(void);
+
+/* --------------------------------------------------[ Random pools ]---- */
+
+/* Copy up to 'count' pre-generated random bytes from this CPU's pool.
+ * Returns the number copied; never sleeps.
+ */
+size_t gfshare_rand_pool_take(uint8_t* buffer, size_t count);
+
+int gfshare_rand_pool_init(void);
+void gfshare_rand_pool_exit(void);
+
+/* ------------------------------------------------------[ Statistics ]---- */
+
+/* Phases timed for the tracepoints and the debugfs histograms */
+enum gfshare_stat {
+  GFSHARE_STAT_RAND,        /* random coefficient fill */
+  GFSHARE_STAT_ENC_EVAL,    /* polynomial evaluation for every share */
+  GFSHARE_STAT_ENC_SHARE,   /* the part of that for one share and tile */
+  GFSHARE_STAT_DEC_INTERP,  /* Lagrange interpolation */
+  GFSHARE_STAT_NR,
+};
+
+/* On while any gfshare tracepoint or the debugfs statistics are enabled */
+DECLARE_STATIC_KEY_FALSE(gfshare_timing_key);
+
+void _gfshare_stat_record(enum gfshare_stat stat, uint64_t start, size_t bytes);
+void _gfshare_stat_record_share(uint8_t sharenr, uint64_t start, size_t bytes);
+
+/* Bracket a phase with these. When timing is off, both are a patched-out
+ * branch and the clock is never read.
+ */
+static inline uint64_t gfshare_stat_begin(void)
+{
+  if(static_branch_unlikely(&gfshare_timing_key))
+    return ktime_get_ns();
+  return 0;
+}
+
+static inline void gfshare_stat_end(enum gfshare_stat stat, uint64_t start,
+                                    size_t bytes)
+{
+  if(static_branch_unlikely(&gfshare_timing_key) && start)
+    _gfshare_stat_record(stat, start, bytes);
+}
+
+/* As gfshare_stat_end for GFSHARE_STAT_ENC_SHARE, naming the share */
+static inline void gfshare_stat_end_share(uint8_t sharenr, uint64_t start,
+                                          size_t bytes)
+{
+  if(static_branch_unlikely(&gfshare_timing_key) && start)
+    _gfshare_stat_record_share(sharenr, start, bytes);
+}
+
+/* Tracepoint registration hooks, they hold a reference on the timing key */
+int gfshare_trace_reg(void);
+void gfshare_trace_unreg(void);
+
+void gfshare_stats_init(void);
+void gfshare_stats_exit(void);
+
+#endif /* LIBGFSHARE_INTERNAL_H */
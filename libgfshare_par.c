@@ -0,0 +1,167 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Parallel split and combine for large secrets.
+ *
+ * Byte columns are independent, so the secret is cut into contiguous
+ * ranges and each range is handled by a work item on an unbound workqueue,
+ * the caller doing the first one itself. For a split, every worker also
+ * fills its own slice of each random coefficient row, so random generation
+ * is spread out too: each draws from its own CPU's pool, or runs the random
+ * backend under its own key/IV, giving every CPU an independent stream.
+ * The caller waits for the workers, so only contexts it has marked with
+ * gfshare_ctx_set_parallel are ever cut up.
+ */
+
+#include "libgfshare_internal.h"
+
+#include <linux/cpumask.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+static unsigned int parallel_min_kb = 1024;
+module_param(parallel_min_kb, uint, 0644);
+MODULE_PARM_DESC(parallel_min_kb, "Smallest secret in KiB split or recombined across CPUs, 0 to disable");
+
+#define GFSHARE_PAR_MAX_PARTS 32
+#define GFSHARE_PAR_MIN_PART (128 * 1024)
+
+struct gfshare_par_part {
+  struct work_struct work;
+  const gfshare_ctx* ctx;
+  const uint8_t* secret;
+  uint8_t** shares;
+  uint8_t* secretbuf;
+  uint32_t start;
+  uint32_t count;
+};
+
+static struct workqueue_struct* gfshare_par_wq;
+
+static void _gfshare_par_enc_work(struct work_struct* work)
+{
+  struct gfshare_par_part* part = container_of(work, struct gfshare_par_part, work);
+  const gfshare_ctx* ctx = part->ctx;
+  uint32_t coefficient;
+
+  for(coefficient = 0; coefficient < ctx->threshold - 1; coefficient++) {
+    _gfshare_ctx_fill_rand(ctx, ctx->buffer + coefficient * ctx->maxsize + part->start,
+                           part->count);
+  }
+  _gfshare_enc_eval(ctx, ctx->buffer, ctx->maxsize, part->secret, part->shares,
+                    part->start, part->count);
+}
+
+static void _gfshare_par_dec_work(struct work_struct* work)
+{
+  struct gfshare_par_part* part = container_of(work, struct gfshare_par_part, work);
+
+  _gfshare_dec_extract_range(part->ctx, part->secretbuf + part->start,
+                             part->start, part->count);
+}
+
+/* How many ranges to cut this context's secret into; 1 means don't bother */
+static uint32_t _gfshare_par_parts(const gfshare_ctx* ctx)
+{
+  uint32_t parts;
+
+  if(gfshare_par_wq == NULL || parallel_min_kb == 0 || !ctx->parallel ||
+     ctx->size < parallel_min_kb * 1024) {
+    return 1;
+  }
+  parts = min_t(uint32_t, num_online_cpus(), ctx->size / GFSHARE_PAR_MIN_PART);
+  return clamp_t(uint32_t, parts, 1, GFSHARE_PAR_MAX_PARTS);
+}
+
+int _gfshare_par_wanted(const gfshare_ctx* ctx)
+{
+  return _gfshare_par_parts(ctx) > 1;
+}
+
+static int _gfshare_par_run(const gfshare_ctx* ctx, work_func_t fn,
+                            const uint8_t* secret, uint8_t** shares,
+                            uint8_t* secretbuf)
+{
+  struct gfshare_par_part* part;
+  uint32_t parts, step, pos, p;
+
+  parts = _gfshare_par_parts(ctx);
+  if(parts < 2) {
+    return 1;
+  }
+  part = kmalloc_array(parts, sizeof(*part), GFP_KERNEL);
+  if(part == NULL) {
+    return 1;
+  }
+
+  step = ALIGN(DIV_ROUND_UP(ctx->size, parts), 64);
+  for(p = 0, pos = 0; p < parts && pos < ctx->size; p++, pos += step) {
+    part[p].ctx = ctx;
+    part[p].secret = secret;
+    part[p].shares = shares;
+    part[p].secretbuf = secretbuf;
+    part[p].start = pos;
+    part[p].count = min_t(uint32_t, step, ctx->size - pos);
+    INIT_WORK(&part[p].work, fn);
+    if(p > 0) {
+      queue_work(gfshare_par_wq, &part[p].work);
+    }
+  }
+  parts = p;
+
+  fn(&part[0].work);
+  for(p = 1; p < parts; p++) {
+    flush_work(&part[p].work);
+  }
+  kfree(part);
+  return 0;
+}
+
+int _gfshare_par_getshares(const gfshare_ctx* ctx, const uint8_t* secret,
+                           uint8_t** shares)
+{
+  return _gfshare_par_run(ctx, _gfshare_par_enc_work, secret, shares, NULL);
+}
+
+int _gfshare_par_extract(const gfshare_ctx* ctx, uint8_t* secretbuf)
+{
+  return _gfshare_par_run(ctx, _gfshare_par_dec_work, NULL, NULL, secretbuf);
+}
+
+int _gfshare_par_init(void)
+{
+  gfshare_par_wq = alloc_workqueue("gfshare_par", WQ_UNBOUND | WQ_HIGHPRI, 0);
+  return gfshare_par_wq ? 0 : -ENOMEM;
+}
+
+void _gfshare_par_exit(void)
+{
+  if(gfshare_par_wq) {
+    destroy_workqueue(gfshare_par_wq);
+    gfshare_par_wq = NULL;
+  }
+}
@@ -0,0 +1,206 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Per-CPU pools of pre-generated random bytes for gfshare_fill_rand.
+ *
+ * Each CPU owns two buffers of rand_pool_kb KiB. Callers drain the active
+ * one of the pool of the CPU they are on, under that pool's own lock (so
+ * only ever contended if the caller migrates or the refill work runs on
+ * another CPU after hotplug), and when it runs dry they switch to the
+ * spare if the refill work has marked it full. Once the bytes left on a
+ * CPU (active plus spare) drop below the low watermark the refill work is
+ * queued on that CPU; it generates a fresh spare with the module's random
+ * backend, so the pool stays between the low watermark and the high
+ * watermark of two full buffers. Consumed bytes are wiped as they are
+ * handed out.
+ */
+
+#include "libgfshare_internal.h"
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/workqueue.h>
+
+static unsigned int rand_pool_kb = 32;
+module_param(rand_pool_kb, uint, 0444);
+MODULE_PARM_DESC(rand_pool_kb, "Per-CPU random pool buffer size in KiB, 0 to disable");
+
+struct gfshare_rand_pool {
+    spinlock_t lock;
+    int cpu;            /* owner, where the refill work is queued */
+    uint8_t *buf[2];
+    int cur;            /* buffer being drained */
+    size_t avail;       /* unread bytes at the end of buf[cur] */
+    bool spare_ready;   /* buf[cur ^ 1] is full */
+    bool refilling;     /* refill work queued or running */
+    struct work_struct refill;
+};
+
+static DEFINE_PER_CPU(struct gfshare_rand_pool, gfshare_rand_pools);
+
+static struct workqueue_struct *gfshare_rand_wq;
+static size_t pool_bytes;     /* size of one buffer, 0 when disabled */
+static size_t pool_low;       /* low watermark */
+
+static void gfshare_rand_pool_generate(uint8_t *buf, size_t len)
+{
+    gfshare_rand->generate(gfshare_rand, buf, len);
+}
+
+/* The spare buffer is never read by callers until spare_ready is set, so
+ * it can be generated with preemption and interrupts enabled. cur can't
+ * change while refilling is set, as there is no spare to switch to.
+ */
+static void gfshare_rand_pool_refill(struct work_struct *work)
+{
+    struct gfshare_rand_pool *pool =
+        container_of(work, struct gfshare_rand_pool, refill);
+    unsigned long flags;
+    uint8_t *spare;
+
+    spin_lock_irqsave(&pool->lock, flags);
+    spare = pool->buf[pool->cur ^ 1];
+    spin_unlock_irqrestore(&pool->lock, flags);
+
+    gfshare_rand_pool_generate(spare, pool_bytes);
+
+    spin_lock_irqsave(&pool->lock, flags);
+    pool->spare_ready = true;
+    pool->refilling = false;
+    spin_unlock_irqrestore(&pool->lock, flags);
+}
+
+/**
+ * Copy up to count pre-generated bytes from this CPU's pool into buffer.
+ * Returns how many were copied; the caller generates the rest inline.
+ */
+size_t gfshare_rand_pool_take(uint8_t *buffer, size_t count)
+{
+    struct gfshare_rand_pool *pool;
+    unsigned long flags;
+    size_t done = 0, n;
+    uint8_t *src;
+
+    if (!pool_bytes)
+        return 0;
+
+    /* Migrating after this only means draining another CPU's pool */
+    pool = raw_cpu_ptr(&gfshare_rand_pools);
+    spin_lock_irqsave(&pool->lock, flags);
+
+    while (done < count) {
+        if (pool->avail == 0) {
+            if (!pool->spare_ready)
+                break;
+            pool->cur ^= 1;
+            pool->avail = pool_bytes;
+            pool->spare_ready = false;
+        }
+        n = min(pool->avail, count - done);
+        src = pool->buf[pool->cur] + pool_bytes - pool->avail;
+        memcpy(buffer + done, src, n);
+        memzero_explicit(src, n);
+        pool->avail -= n;
+        done += n;
+    }
+
+    if (!pool->refilling && !pool->spare_ready && pool->avail < pool_low) {
+        pool->refilling = true;
+        queue_work_on(pool->cpu, gfshare_rand_wq, &pool->refill);
+    }
+    spin_unlock_irqrestore(&pool->lock, flags);
+
+    return done;
+}
+
+static void gfshare_rand_pool_free_buffers(void)
+{
+    struct gfshare_rand_pool *pool;
+    int cpu, i;
+
+    for_each_possible_cpu(cpu) {
+        pool = per_cpu_ptr(&gfshare_rand_pools, cpu);
+        for (i = 0; i < 2; i++) {
+            kfree_sensitive(pool->buf[i]);
+            pool->buf[i] = NULL;
+        }
+    }
+}
+
+int gfshare_rand_pool_init(void)
+{
+    struct gfshare_rand_pool *pool;
+    int cpu, i;
+
+    if (!rand_pool_kb)
+        return 0;
+
+    gfshare_rand_wq = alloc_workqueue("gfshare_rand", WQ_MEM_RECLAIM, 0);
+    if (!gfshare_rand_wq)
+        return -ENOMEM;
+
+    for_each_possible_cpu(cpu) {
+        pool = per_cpu_ptr(&gfshare_rand_pools, cpu);
+        spin_lock_init(&pool->lock);
+        pool->cpu = cpu;
+        INIT_WORK(&pool->refill, gfshare_rand_pool_refill);
+        for (i = 0; i < 2; i++) {
+            pool->buf[i] = kmalloc(rand_pool_kb * 1024, GFP_KERNEL);
+            if (!pool->buf[i])
+                goto fail;
+            gfshare_rand_pool_generate(pool->buf[i], rand_pool_kb * 1024);
+        }
+        pool->cur = 0;
+        pool->avail = rand_pool_kb * 1024;
+        pool->spare_ready = true;
+        pool->refilling = false;
+    }
+
+    pool_bytes = rand_pool_kb * 1024;
+    pool_low = pool_bytes / 2;
+    return 0;
+
+fail:
+    gfshare_rand_pool_free_buffers();
+    destroy_workqueue(gfshare_rand_wq);
+    gfshare_rand_wq = NULL;
+    return -ENOMEM;
+}
+
+void gfshare_rand_pool_exit(void)
+{
+    if (!gfshare_rand_wq)
+        return;
+
+    pool_bytes = 0;
+    destroy_workqueue(gfshare_rand_wq);
+    gfshare_rand_wq = NULL;
+    gfshare_rand_pool_free_buffers();
+}
@@ -0,0 +1,176 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Ramp (packed) sharing: shares a fraction of the size of the secret.
+ *
+ * With privacy t < threshold k, the secret is cut into L = k - t pieces of
+ * m = ceil(size / L) bytes (the last one zero padded). They become the L
+ * low coefficients of a degree k - 1 polynomial, piece d at degree L-1-d,
+ * and the t coefficients above them are random. Each share is the
+ * polynomial at the share's x, m bytes long. Any k shares give back the
+ * whole polynomial and so the secret; t or fewer say nothing about it,
+ * because for a fixed secret the random part maps one-to-one onto their
+ * values. Between the two, information leaks in proportion. t = k - 1 is
+ * plain Shamir, and t = 0 is an information dispersal with no privacy.
+ *
+ * In the encoder's buffer the coefficients are rows of m bytes from the
+ * top degree down: t random rows, then the pieces in order, which is the
+ * layout _gfshare_enc_eval takes with the constant term as its last row.
+ */
+
+#include "libgfshare_internal.h"
+#include "libgfshare_tables.h"
+
+#include <linux/kernel.h>
+#include <linux/string.h>
+
+static gfshare_ctx* _gfshare_ctx_ramp(gfshare_ctx* ctx, uint32_t privacy)
+{
+  if(ctx != NULL) {
+    ctx->chunks = ctx->threshold - privacy;
+  }
+  return ctx;
+}
+
+/* Initialise a ramp context for producing shares */
+gfshare_ctx* gfshare_ctx_init_enc_ramp(const uint8_t* sharenrs,
+                                       uint32_t sharecount,
+                                       uint32_t threshold,
+                                       uint32_t privacy,
+                                       size_t maxsize)
+{
+  if(privacy >= threshold) {
+    return NULL;
+  }
+  return _gfshare_ctx_ramp(gfshare_ctx_init_enc(sharenrs, sharecount,
+                                                threshold, maxsize), privacy);
+}
+
+/* Initialise a ramp context for recombining shares */
+gfshare_ctx* gfshare_ctx_init_dec_ramp(const uint8_t* sharenrs,
+                                       uint32_t sharecount,
+                                       uint32_t threshold,
+                                       uint32_t privacy,
+                                       size_t maxsize)
+{
+  if(privacy >= threshold) {
+    return NULL;
+  }
+  return _gfshare_ctx_ramp(gfshare_ctx_init_dec(sharenrs, sharecount,
+                                                threshold, maxsize), privacy);
+}
+
+/* Split a secret of 'size' bytes into shares of gfshare_ctx_sharesize */
+void _gfshare_ramp_getshares(const gfshare_ctx* ctx, const uint8_t* secret,
+                             uint8_t** shares)
+{
+  size_t m = gfshare_ctx_sharesize(ctx);
+  uint32_t random = ctx->threshold - ctx->chunks;
+  uint8_t* pieces = ctx->buffer + random * m;
+
+  _gfshare_ctx_fill_rand(ctx, ctx->buffer, random * m);
+  memcpy(pieces, secret, ctx->size);
+  memset(pieces + ctx->size, 0, ctx->chunks * m - ctx->size);
+  _gfshare_enc_eval(ctx, ctx->buffer, m, ctx->buffer + (ctx->threshold - 1) * m,
+                    shares, 0, m);
+}
+
+/* Multiply poly (degree 'deg') by (x + r) in place */
+static void _gfshare_ramp_poly_mul(uint8_t* poly, uint32_t deg, uint8_t r)
+{
+  uint32_t i;
+
+  poly[deg + 1] = poly[deg];
+  for(i = deg; i > 0; i--) {
+    poly[i] = poly[i - 1] ^ gfshare_gf_mul(r, poly[i]);
+  }
+  poly[0] = gfshare_gf_mul(r, poly[0]);
+}
+
+/* q = the product of (x + x_j) over the shares in the current plan */
+void _gfshare_ramp_product(const gfshare_ctx* ctx, uint8_t q[256])
+{
+  const struct gfshare_dec_plan* plan = ctx->plan;
+  uint32_t n;
+
+  memset(q, 0, 256);
+  q[0] = 1;
+  for(n = 0; n < plan->count; n++) {
+    _gfshare_ramp_poly_mul(q, n, ctx->sharenrs[plan->index[n]]);
+  }
+}
+
+/* basis[d] = the x^d coefficient of the Lagrange basis polynomial of the
+ * plan's n'th share, prod_{j != n} (x - x_j) / (x_n - x_j). The numerator
+ * is q / (x + x_n) by synthetic division, and the denominator is the
+ * numerator at x_n.
+ */
+void _gfshare_ramp_basis(const gfshare_ctx* ctx, const uint8_t q[256],
+                         uint32_t n, uint8_t basis[256])
+{
+  uint32_t count = ctx->plan->count, i;
+  uint8_t x = ctx->sharenrs[ctx->plan->index[n]], denom = 0;
+
+  memset(basis, 0, 256);
+  basis[count - 1] = q[count];
+  for(i = count - 1; i > 0; i--) {
+    basis[i - 1] = q[i] ^ gfshare_gf_mul(x, basis[i]);
+  }
+  for(i = count; i-- > 0; ) {
+    denom = gfshare_gf_mul(denom, x) ^ basis[i];
+  }
+  denom = exps[0xff - logs[denom]];
+  for(i = 0; i < count; i++) {
+    basis[i] = gfshare_gf_mul(basis[i], denom);
+  }
+}
+
+/* For each piece that [start, start + count) touches, interpolate just
+ * those columns of its coefficient (piece d is the degree L-1-d one).
+ */
+void _gfshare_ramp_extract_range(const gfshare_ctx* ctx, uint8_t* out,
+                                 size_t start, size_t count)
+{
+  const struct gfshare_dec_plan* plan = ctx->plan;
+  size_t m = gfshare_ctx_sharesize(ctx), from, to;
+  uint8_t q[256], basis[256];
+  uint64_t t0 = gfshare_stat_begin();
+  uint32_t n, d;
+
+  memset(out, 0, count);
+  _gfshare_ramp_product(ctx, q);
+  for(n = 0; n < plan->count; n++) {
+    _gfshare_ramp_basis(ctx, q, n, basis);
+    for(d = start / m; d < ctx->chunks && d * m < start + count; d++) {
+      from = max_t(size_t, start, d * m);
+      to = min_t(size_t, start + count, (d + 1) * m);
+      ctx->gf->mul_xor(out + (from - start),
+                       ctx->buffer + ctx->maxsize * plan->index[n] + from - d * m,
+                       out + (from - start), basis[ctx->chunks - 1 - d],
+                       to - from);
+    }
+  }
+  gfshare_stat_end(GFSHARE_STAT_DEC_INTERP, t0, count);
+}
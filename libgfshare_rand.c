@@ -0,0 +1,315 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Registry of keystream generators for the random coefficients.
+ *
+ * "speck" is our own Speck-CTR, keyed afresh on every call. "chacha20" and
+ * "aes-ctr" go through the crypto API so they pick up whatever accelerated
+ * implementation the kernel has (AVX2 ChaCha, AES-NI). Those are keyed
+ * afresh from get_random_bytes for every chunk of at most
+ * GFSHARE_SKCIPHER_CHUNK bytes, and the key is overwritten once the chunk
+ * is done, so no key outlives the coefficients it made. Each CPU has its
+ * own tfm for that, used with bottom halves off. Each available backend is
+ * timed at load, and with rand_backend=auto the fastest becomes the module
+ * default.
+ */
+
+#include "libgfshare_internal.h"
+
+#include <crypto/skcipher.h>
+#include <linux/bottom_half.h>
+#include <linux/err.h>
+#include <linux/irqflags.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/preempt.h>
+#include <linux/random.h>
+#include <linux/scatterlist.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/timekeeping.h>
+
+static char *rand_backend = "auto";
+module_param(rand_backend, charp, 0444);
+MODULE_PARM_DESC(rand_backend, "Random coefficient generator: auto, speck, chacha20 or aes-ctr");
+
+/* Bytes encrypted per key. This also bounds how long bottom halves stay
+ * off, and is well inside the counter space of a zero IV.
+ */
+#define GFSHARE_SKCIPHER_CHUNK (64 * 1024)
+
+#define GFSHARE_RAND_BENCH_BYTES (64 * 1024)
+#define GFSHARE_RAND_BENCH_RUNS 4
+
+/* -----------------------------------------------------------[ Speck ]---- */
+
+static void gfshare_rand_speck_generate(struct gfshare_rand_backend *be,
+                                        uint8_t *buffer, size_t count)
+{
+    uint8_t key[16];
+
+    get_random_bytes(key, sizeof(key));
+    generate_block_ctr(count, buffer, key);
+    memzero_explicit(key, sizeof(key));
+}
+
+static struct gfshare_rand_backend gfshare_rand_speck = {
+    .name = "speck",
+    .generate = gfshare_rand_speck_generate,
+    .available = true,
+};
+
+/* -------------------------------------------------------[ skcipher ]---- */
+
+struct gfshare_skcipher_state {
+    const char *alg;
+    unsigned int keylen;
+    struct crypto_sync_skcipher * __percpu *tfms;
+};
+
+static void gfshare_rand_skcipher_exit(struct gfshare_rand_backend *be)
+{
+    struct gfshare_skcipher_state *st = be->priv;
+    int cpu;
+
+    if (!st->tfms)
+        return;
+    for_each_possible_cpu(cpu)
+        crypto_free_sync_skcipher(*per_cpu_ptr(st->tfms, cpu));
+    free_percpu(st->tfms);
+    st->tfms = NULL;
+}
+
+static int gfshare_rand_skcipher_init(struct gfshare_rand_backend *be)
+{
+    struct gfshare_skcipher_state *st = be->priv;
+    struct crypto_sync_skcipher *tfm;
+    int cpu;
+
+    st->tfms = alloc_percpu(struct crypto_sync_skcipher *);
+    if (!st->tfms)
+        return -ENOMEM;
+    for_each_possible_cpu(cpu) {
+        tfm = crypto_alloc_sync_skcipher(st->alg, 0, 0);
+        if (IS_ERR(tfm)) {
+            gfshare_rand_skcipher_exit(be);
+            return PTR_ERR(tfm);
+        }
+        *per_cpu_ptr(st->tfms, cpu) = tfm;
+    }
+    return 0;
+}
+
+static int gfshare_rand_skcipher_setkey(struct gfshare_skcipher_state *st,
+                                        struct crypto_sync_skcipher *tfm)
+{
+    uint8_t key[32];
+    int err;
+
+    get_random_bytes(key, st->keylen);
+    err = crypto_sync_skcipher_setkey(tfm, key, st->keylen);
+    memzero_explicit(key, sizeof(key));
+    return err;
+}
+
+/* Encrypt zeros under a fresh key and a zero IV, then replace the key */
+static int gfshare_rand_skcipher_chunk(struct gfshare_skcipher_state *st,
+                                       struct crypto_sync_skcipher *tfm,
+                                       uint8_t *buffer, size_t len)
+{
+    SYNC_SKCIPHER_REQUEST_ON_STACK(req, tfm);
+    struct scatterlist sg;
+    uint8_t iv[16] = { 0 };
+    int err;
+
+    err = gfshare_rand_skcipher_setkey(st, tfm);
+    if (err)
+        return err;
+    memset(buffer, 0, len);
+    sg_init_one(&sg, buffer, len);
+    skcipher_request_set_sync_tfm(req, tfm);
+    skcipher_request_set_callback(req, 0, NULL, NULL);
+    skcipher_request_set_crypt(req, &sg, &sg, len, iv);
+    err = crypto_skcipher_encrypt(req);
+    skcipher_request_zero(req);
+    gfshare_rand_skcipher_setkey(st, tfm);
+    return err;
+}
+
+/* The buffer goes into a scatterlist, so it has to be in the linear map.
+ * Anything else (vmalloc, a virtually mapped stack) is handed to Speck, as
+ * are callers in hard interrupt context, which could land in the middle of
+ * this CPU's tfm being used.
+ */
+static void gfshare_rand_skcipher_generate(struct gfshare_rand_backend *be,
+                                           uint8_t *buffer, size_t count)
+{
+    struct gfshare_skcipher_state *st = be->priv;
+    size_t chunk;
+    int err;
+
+    if (count == 0)
+        return;
+    if (!virt_addr_valid(buffer) || !virt_addr_valid(buffer + count - 1) ||
+        in_hardirq() || irqs_disabled()) {
+        gfshare_rand_speck_generate(&gfshare_rand_speck, buffer, count);
+        return;
+    }
+
+    while (count) {
+        chunk = min_t(size_t, count, GFSHARE_SKCIPHER_CHUNK);
+        local_bh_disable();
+        err = gfshare_rand_skcipher_chunk(st, *this_cpu_ptr(st->tfms),
+                                          buffer, chunk);
+        local_bh_enable();
+        if (err)
+            gfshare_rand_speck_generate(&gfshare_rand_speck, buffer, chunk);
+        buffer += chunk;
+        count -= chunk;
+    }
+}
+
+static struct gfshare_skcipher_state gfshare_chacha20_state = {
+    .alg = "chacha20",
+    .keylen = 32,
+};
+
+static struct gfshare_rand_backend gfshare_rand_chacha20 = {
+    .name = "chacha20",
+    .init = gfshare_rand_skcipher_init,
+    .exit = gfshare_rand_skcipher_exit,
+    .generate = gfshare_rand_skcipher_generate,
+    .priv = &gfshare_chacha20_state,
+};
+
+static struct gfshare_skcipher_state gfshare_aes_ctr_state = {
+    .alg = "ctr(aes)",
+    .keylen = 16,
+};
+
+static struct gfshare_rand_backend gfshare_rand_aes_ctr = {
+    .name = "aes-ctr",
+    .init = gfshare_rand_skcipher_init,
+    .exit = gfshare_rand_skcipher_exit,
+    .generate = gfshare_rand_skcipher_generate,
+    .priv = &gfshare_aes_ctr_state,
+};
+
+/* -------------------------------------------------------[ Registry ]---- */
+
+static struct gfshare_rand_backend *gfshare_rand_backends[] = {
+    &gfshare_rand_speck,
+    &gfshare_rand_chacha20,
+    &gfshare_rand_aes_ctr,
+};
+
+struct gfshare_rand_backend *gfshare_rand = &gfshare_rand_speck;
+
+/* Look up an available backend by name */
+struct gfshare_rand_backend *gfshare_rand_find(const char *name)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(gfshare_rand_backends); i++) {
+        if (gfshare_rand_backends[i]->available &&
+            !strcmp(gfshare_rand_backends[i]->name, name))
+            return gfshare_rand_backends[i];
+    }
+    return NULL;
+}
+
+/* Record throughput in MB/s; a warm-up run first so that lazily set up
+ * state (FPU, tfm internals) isn't counted.
+ */
+static void gfshare_rand_bench(struct gfshare_rand_backend *be, uint8_t *buf)
+{
+    uint64_t start, ns;
+    int i;
+
+    be->generate(be, buf, GFSHARE_RAND_BENCH_BYTES);
+    start = ktime_get_ns();
+    for (i = 0; i < GFSHARE_RAND_BENCH_RUNS; i++)
+        be->generate(be, buf, GFSHARE_RAND_BENCH_BYTES);
+    ns = max_t(uint64_t, ktime_get_ns() - start, 1);
+    be->mbps = (uint64_t)GFSHARE_RAND_BENCH_BYTES * GFSHARE_RAND_BENCH_RUNS *
+               1000 / ns;
+}
+
+int gfshare_rand_init(void)
+{
+    struct gfshare_rand_backend *be, *best = &gfshare_rand_speck;
+    uint8_t *buf;
+    int i;
+
+    buf = kmalloc(GFSHARE_RAND_BENCH_BYTES, GFP_KERNEL);
+    if (!buf)
+        return -ENOMEM;
+
+    for (i = 0; i < ARRAY_SIZE(gfshare_rand_backends); i++) {
+        be = gfshare_rand_backends[i];
+        if (be->init && be->init(be)) {
+            printk(KERN_INFO "gfshare: %s random backend unavailable\n", be->name);
+            continue;
+        }
+        be->available = true;
+        gfshare_rand_bench(be, buf);
+        printk(KERN_INFO "gfshare: %s random backend %llu MB/s\n",
+               be->name, (unsigned long long)be->mbps);
+        if (be->mbps > best->mbps)
+            best = be;
+    }
+    kfree_sensitive(buf);
+
+    if (strcmp(rand_backend, "auto")) {
+        be = gfshare_rand_find(rand_backend);
+        if (be)
+            best = be;
+        else
+            printk(KERN_WARNING "gfshare: no random backend '%s', using %s\n",
+                   rand_backend, best->name);
+    }
+
+    gfshare_rand = best;
+    printk(KERN_INFO "gfshare: using %s random backend\n", best->name);
+    return 0;
+}
+
+void gfshare_rand_exit(void)
+{
+    struct gfshare_rand_backend *be;
+    int i;
+
+    gfshare_rand = &gfshare_rand_speck;
+    for (i = 0; i < ARRAY_SIZE(gfshare_rand_backends); i++) {
+        be = gfshare_rand_backends[i];
+        if (!be->init)
+            continue;
+        if (be->available && be->exit)
+            be->exit(be);
+        be->available = false;
+    }
+}
@@ -0,0 +1,244 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Split and recombine straight from scatterlists.
+ *
+ * The secret and every share are walked in lockstep, one step at a time,
+ * where a step is as long as the shortest run left before any list crosses
+ * a page or an entry boundary. Each step maps those pages, works on them
+ * in place and unmaps them again, so page-cache pages and bio pages never
+ * have to be linearised first. Bios can be handed over with blk_rq_map_sg()
+ * or a bio_vec walk filling a table of entries.
+ */
+
+#include "libgfshare_internal.h"
+
+#include <linux/highmem.h>
+#include <linux/kernel.h>
+#include <linux/scatterlist.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+/* The encoder maps every share at once, and kmap_local_page() slots are
+ * few on 32 bit highmem kernels.
+ */
+#define GFSHARE_SG_HIGHMEM_MAPS 12
+
+struct gfshare_sg_cursor {
+  struct scatterlist* sg;
+  size_t off;      /* bytes of sg already consumed */
+  uint8_t* map;    /* mapping of the current step, or NULL */
+};
+
+/* Bytes the list can supply, stopping once 'need' is reached */
+static size_t _gfshare_sg_len(struct scatterlist* sg, size_t need)
+{
+  size_t len = 0;
+
+  for(; sg != NULL && len < need; sg = sg_next(sg)) {
+    len += sg->length;
+  }
+  return len;
+}
+
+/* Step past exhausted entries; returns the run left in the current page */
+static size_t _gfshare_sg_avail(struct gfshare_sg_cursor* cur)
+{
+  size_t pgoff;
+
+  while(cur->off == cur->sg->length) {
+    cur->sg = sg_next(cur->sg);
+    cur->off = 0;
+  }
+  pgoff = cur->sg->offset + cur->off;
+  return min_t(size_t, cur->sg->length - cur->off,
+               PAGE_SIZE - offset_in_page(pgoff));
+}
+
+static uint8_t* _gfshare_sg_map(struct gfshare_sg_cursor* cur)
+{
+  size_t pgoff = cur->sg->offset + cur->off;
+
+  cur->map = kmap_local_page(nth_page(sg_page(cur->sg), pgoff >> PAGE_SHIFT));
+  return cur->map + offset_in_page(pgoff);
+}
+
+/* Unmap and advance; mappings are released in reverse order of mapping */
+static void _gfshare_sg_unmap(struct gfshare_sg_cursor* cur, size_t len)
+{
+  kunmap_local(cur->map);
+  cur->map = NULL;
+  cur->off += len;
+}
+
+/* One cursor per list, lists[index[i]] or lists[i] if index is NULL, and
+ * if 'ptrs' is given room for a pointer per list
+ */
+static struct gfshare_sg_cursor* _gfshare_sg_cursors(struct scatterlist** lists,
+                                                     const uint32_t* index,
+                                                     uint32_t count,
+                                                     uint8_t*** ptrs)
+{
+  struct gfshare_sg_cursor* cur;
+  uint32_t i;
+
+  cur = kmalloc_array(count, sizeof(*cur) + (ptrs ? sizeof(uint8_t*) : 0),
+                      GFP_KERNEL);
+  if(cur == NULL) {
+    return NULL;
+  }
+  for(i = 0; i < count; i++) {
+    cur[i].sg = lists[index ? index[i] : i];
+    cur[i].off = 0;
+    cur[i].map = NULL;
+  }
+  if(ptrs != NULL) {
+    *ptrs = (uint8_t**)(cur + count);
+  }
+  return cur;
+}
+
+/* Split a secret held in a scatterlist into shares held in scatterlists.
+ * shares[i] receives share i and, like 'secret', must cover 'size' bytes.
+ */
+int gfshare_ctx_enc_getshares_sg(const gfshare_ctx* ctx,
+                                 struct scatterlist* secret,
+                                 struct scatterlist** shares)
+{
+  struct gfshare_sg_cursor *cur, sec = { secret, 0, NULL };
+  uint8_t** out;
+  const uint8_t* in;
+  uint32_t pos, i;
+  size_t len;
+
+  if(!_gfshare_ctx_plain(ctx)) {
+    return 1;
+  }
+  if(IS_ENABLED(CONFIG_HIGHMEM) && ctx->sharecount + 1 > GFSHARE_SG_HIGHMEM_MAPS) {
+    return 1;
+  }
+  if(_gfshare_sg_len(secret, ctx->size) < ctx->size) {
+    return 1;
+  }
+  for(i = 0; i < ctx->sharecount; i++) {
+    if(_gfshare_sg_len(shares[i], ctx->size) < ctx->size) {
+      return 1;
+    }
+  }
+  cur = _gfshare_sg_cursors(shares, NULL, ctx->sharecount, &out);
+  if(cur == NULL) {
+    return 1;
+  }
+
+  _gfshare_ctx_fill_rand(ctx, ctx->buffer, (ctx->threshold-1) * ctx->maxsize);
+
+  for(pos = 0; pos < ctx->size; pos += len) {
+    len = min_t(size_t, _gfshare_sg_avail(&sec), ctx->size - pos);
+    for(i = 0; i < ctx->sharecount; i++) {
+      len = min(len, _gfshare_sg_avail(&cur[i]));
+    }
+
+    in = _gfshare_sg_map(&sec);
+    for(i = 0; i < ctx->sharecount; i++) {
+      out[i] = _gfshare_sg_map(&cur[i]);
+    }
+    _gfshare_enc_eval(ctx, ctx->buffer + pos, ctx->maxsize, in, out, 0, len);
+    for(i = ctx->sharecount; i-- > 0; ) {
+      _gfshare_sg_unmap(&cur[i], len);
+    }
+    _gfshare_sg_unmap(&sec, len);
+  }
+
+  kfree(cur);
+  return 0;
+}
+
+/* Recombine straight from shares held in scatterlists into a secret held
+ * in one. shares[i] is share i (an index into the sharenrs array) and must
+ * cover 'size' bytes; shares the current sharenrs mark as absent may be
+ * NULL. Only the secret and one share page are mapped at any time, except
+ * with a specialised combine kernel, which takes all of its (at most
+ * GFSHARE_SPEC_MAX_SHARES) shares at once.
+ */
+int gfshare_ctx_dec_extract_sg(const gfshare_ctx* ctx,
+                               struct scatterlist** shares,
+                               struct scatterlist* secret)
+{
+  const struct gfshare_dec_plan* plan = ctx->plan;
+  struct gfshare_sg_cursor *cur, sec = { secret, 0, NULL };
+  const uint8_t* ins[GFSHARE_SPEC_MAX_SHARES];
+  const uint8_t* in;
+  uint8_t* out;
+  uint64_t t0;
+  uint32_t pos, n;
+  size_t len;
+
+  if(plan == NULL || !_gfshare_ctx_plain(ctx)) {
+    return 1;
+  }
+  if(_gfshare_sg_len(secret, ctx->size) < ctx->size) {
+    return 1;
+  }
+  for(n = 0; n < plan->count; n++) {
+    if(_gfshare_sg_len(shares[plan->index[n]], ctx->size) < ctx->size) {
+      return 1;
+    }
+  }
+  cur = _gfshare_sg_cursors(shares, plan->index, plan->count, NULL);
+  if(cur == NULL) {
+    return 1;
+  }
+
+  t0 = gfshare_stat_begin();
+  for(pos = 0; pos < ctx->size; pos += len) {
+    len = min_t(size_t, _gfshare_sg_avail(&sec), ctx->size - pos);
+    for(n = 0; n < plan->count; n++) {
+      len = min(len, _gfshare_sg_avail(&cur[n]));
+    }
+
+    out = _gfshare_sg_map(&sec);
+    if(ctx->dec_kernel != NULL && plan->count == ctx->threshold) {
+      for(n = 0; n < plan->count; n++) {
+        ins[n] = _gfshare_sg_map(&cur[n]);
+      }
+      ctx->dec_kernel(out, ins, (const uint8_t (*)[32])plan->nibbles, len);
+      for(n = plan->count; n-- > 0; ) {
+        _gfshare_sg_unmap(&cur[n], len);
+      }
+    } else {
+      memset(out, 0, len);
+      for(n = 0; n < plan->count; n++) {
+        in = _gfshare_sg_map(&cur[n]);
+        ctx->gf->mul_xor_row(out, in, out, plan->rows[n], len);
+        _gfshare_sg_unmap(&cur[n], len);
+      }
+    }
+    _gfshare_sg_unmap(&sec, len);
+  }
+  gfshare_stat_end(GFSHARE_STAT_DEC_INTERP, t0, ctx->size);
+
+  kfree(cur);
+  return 0;
+}
@@ -0,0 +1,375 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Split and combine kernels specialised for the (threshold, sharecount)
+ * pairs in GFSHARE_SPEC_CONFIGS.
+ *
+ * The generic loops call the engine once per (share, coefficient) pair and
+ * tile, so every step goes back through memory. Here threshold and
+ * sharecount are compile-time constants: each share's Horner evaluation (or
+ * the interpolation sum) runs to the end in a register, one 32 byte block
+ * at a time, and the loops over coefficients and shares unroll completely.
+ * Multiplies use the split-nibble tables held in the context and the plans.
+ *
+ * The AVX2 kernels are a series of asm statements on fixed registers inside
+ * one kernel_fpu_begin() section, as lib/raid6 does; nothing else touches
+ * the vector registers because the kernel is built without SSE.
+ */
+
+#include "libgfshare_internal.h"
+
+#include <linux/build_bug.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#ifdef CONFIG_X86_64
+#include <asm/fpu/api.h>
+#include <asm/simd.h>
+#endif
+
+#if defined(__clang__) || __GNUC__ >= 8
+#define GFSHARE_UNROLL _Pragma("GCC unroll 16")
+#else
+#define GFSHARE_UNROLL
+#endif
+
+static const struct gfshare_spec* gfshare_spec_table;
+
+static __always_inline uint8_t _gfshare_spec_mul(const uint8_t* tbl, uint8_t x)
+{
+  return tbl[x & 0x0f] ^ tbl[16 + (x >> 4)];
+}
+
+static __always_inline void _gfshare_spec_enc_scalar(const uint32_t k, const uint32_t n,
+                                                     uint8_t** shares,
+                                                     const uint8_t* coeffs,
+                                                     size_t stride,
+                                                     const uint8_t* secret,
+                                                     const uint8_t (*tbl)[32],
+                                                     uint32_t start, uint32_t count)
+{
+  uint32_t pos, c, j;
+  uint8_t acc;
+
+  for(pos = start; pos < start + count; pos++) {
+    GFSHARE_UNROLL
+    for(j = 0; j < n; j++) {
+      acc = coeffs[pos];
+      GFSHARE_UNROLL
+      for(c = 1; c < k; c++) {
+        acc = _gfshare_spec_mul(tbl[j], acc) ^
+              (c == k - 1 ? secret : coeffs + c * stride)[pos];
+      }
+      shares[j][pos] = acc;
+    }
+  }
+}
+
+static __always_inline void _gfshare_spec_dec_scalar(const uint32_t k, uint8_t* out,
+                                                     const uint8_t* const* in,
+                                                     const uint8_t (*tbl)[32],
+                                                     size_t len)
+{
+  size_t pos;
+  uint32_t n;
+  uint8_t acc;
+
+  for(pos = 0; pos < len; pos++) {
+    acc = 0;
+    GFSHARE_UNROLL
+    for(n = 0; n < k; n++) {
+      acc ^= _gfshare_spec_mul(tbl[n], in[n][pos]);
+    }
+    out[pos] = acc;
+  }
+}
+
+#ifdef CONFIG_X86_64
+
+/* Bytes per kernel_fpu_begin() section, as for the generic engines */
+#define GFSHARE_SPEC_FPU_CHUNK 4096
+
+static const uint8_t gfshare_spec_mask[16] __aligned(16) = {
+  0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f,
+  0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x0f };
+
+#define GFSHARE_SPEC_BLOCK(p) (*(const uint8_t (*)[32])(p))
+#define GFSHARE_SPEC_HALF(p) (*(const uint8_t (*)[16])(p))
+
+/* ymm0 = ymm0 * (the multiplier whose nibble tables are in ymm5/ymm6).
+ * ymm7 holds the nibble mask; ymm1 is scratch.
+ */
+#define GFSHARE_SPEC_AVX2_MUL                 \
+  "vpsrlw  $4, %%ymm0, %%ymm1\n\t"            \
+  "vpand   %%ymm7, %%ymm0, %%ymm0\n\t"        \
+  "vpand   %%ymm7, %%ymm1, %%ymm1\n\t"        \
+  "vpshufb %%ymm0, %%ymm5, %%ymm0\n\t"        \
+  "vpshufb %%ymm1, %%ymm6, %%ymm1\n\t"        \
+  "vpxor   %%ymm1, %%ymm0, %%ymm0\n\t"
+
+static __always_inline void _gfshare_spec_avx2_tables(const uint8_t* tbl)
+{
+  asm volatile("vbroadcasti128 %0, %%ymm5\n\t"
+               "vbroadcasti128 %1, %%ymm6\n\t"
+               : : "m" (GFSHARE_SPEC_HALF(tbl)), "m" (GFSHARE_SPEC_HALF(tbl + 16)));
+}
+
+static __always_inline void _gfshare_spec_enc_avx2(const uint32_t k, const uint32_t n,
+                                                   uint8_t** shares,
+                                                   const uint8_t* coeffs,
+                                                   size_t stride,
+                                                   const uint8_t* secret,
+                                                   const uint8_t (*tbl)[32],
+                                                   uint32_t start, uint32_t count)
+{
+  uint32_t pos = start, end = start + count, stop, c, j;
+  const uint8_t* row;
+
+  if(count >= 32 && may_use_simd()) {
+    while(end - pos >= 32) {
+      stop = pos + (min_t(uint32_t, end - pos, GFSHARE_SPEC_FPU_CHUNK) & ~31u);
+      kernel_fpu_begin();
+      asm volatile("vbroadcasti128 %0, %%ymm7" : : "m" (gfshare_spec_mask));
+      for(; pos < stop; pos += 32) {
+        GFSHARE_UNROLL
+        for(j = 0; j < n; j++) {
+          _gfshare_spec_avx2_tables(tbl[j]);
+          asm volatile("vmovdqu %0, %%ymm0" : : "m" (GFSHARE_SPEC_BLOCK(coeffs + pos)));
+          GFSHARE_UNROLL
+          for(c = 1; c < k; c++) {
+            row = c == k - 1 ? secret : coeffs + c * stride;
+            asm volatile(GFSHARE_SPEC_AVX2_MUL
+                         "vpxor   %0, %%ymm0, %%ymm0\n\t"
+                         : : "m" (GFSHARE_SPEC_BLOCK(row + pos)));
+          }
+          asm volatile("vmovdqu %%ymm0, %0"
+                       : "=m" (*(uint8_t (*)[32])(shares[j] + pos)));
+        }
+      }
+      asm volatile("vzeroupper");
+      kernel_fpu_end();
+    }
+  }
+  _gfshare_spec_enc_scalar(k, n, shares, coeffs, stride, secret, tbl,
+                           pos, end - pos);
+}
+
+static __always_inline void _gfshare_spec_dec_avx2(const uint32_t k, uint8_t* out,
+                                                   const uint8_t* const* in,
+                                                   const uint8_t (*tbl)[32],
+                                                   size_t len)
+{
+  const uint8_t* tail[GFSHARE_SPEC_MAX_SHARES];
+  size_t pos = 0, stop;
+  uint32_t n;
+
+  if(len >= 32 && may_use_simd()) {
+    while(len - pos >= 32) {
+      stop = pos + (min_t(size_t, len - pos, GFSHARE_SPEC_FPU_CHUNK) & ~(size_t)31);
+      kernel_fpu_begin();
+      asm volatile("vbroadcasti128 %0, %%ymm7" : : "m" (gfshare_spec_mask));
+      for(; pos < stop; pos += 32) {
+        asm volatile("vpxor   %ymm2, %ymm2, %ymm2");
+        GFSHARE_UNROLL
+        for(n = 0; n < k; n++) {
+          _gfshare_spec_avx2_tables(tbl[n]);
+          asm volatile("vmovdqu %0, %%ymm0\n\t"
+                       GFSHARE_SPEC_AVX2_MUL
+                       "vpxor   %%ymm0, %%ymm2, %%ymm2\n\t"
+                       : : "m" (GFSHARE_SPEC_BLOCK(in[n] + pos)));
+        }
+        asm volatile("vmovdqu %%ymm2, %0" : "=m" (*(uint8_t (*)[32])(out + pos)));
+      }
+      asm volatile("vzeroupper");
+      kernel_fpu_end();
+    }
+  }
+  if(pos < len) {
+    for(n = 0; n < k; n++) {
+      tail[n] = in[n] + pos;
+    }
+    _gfshare_spec_dec_scalar(k, out + pos, tail, tbl, len - pos);
+  }
+}
+
+#endif /* CONFIG_X86_64 */
+
+/* One out-of-line kernel per engine for each configured pair */
+#define GFSHARE_SPEC_DEFINE(engine, k, n)                                   \
+  static void _gfshare_spec_enc_##engine##_##k##_##n(                       \
+      uint8_t** shares, const uint8_t* coeffs, size_t stride,               \
+      const uint8_t* secret, const uint8_t (*tbl)[32],                      \
+      uint32_t start, uint32_t count)                                       \
+  {                                                                         \
+    _gfshare_spec_enc_##engine(k, n, shares, coeffs, stride, secret, tbl,   \
+                               start, count);                               \
+  }                                                                         \
+  static void _gfshare_spec_dec_##engine##_##k##_##n(                       \
+      uint8_t* out, const uint8_t* const* in, const uint8_t (*tbl)[32],     \
+      size_t len)                                                           \
+  {                                                                         \
+    _gfshare_spec_dec_##engine(k, out, in, tbl, len);                       \
+  }
+
+#define GFSHARE_SPEC_ENTRY(engine, k, n)                                    \
+  { k, n, _gfshare_spec_enc_##engine##_##k##_##n,                           \
+    _gfshare_spec_dec_##engine##_##k##_##n },
+
+#define GFSHARE_SPEC_DEFINE_SCALAR(k, n) GFSHARE_SPEC_DEFINE(scalar, k, n)
+#define GFSHARE_SPEC_ENTRY_SCALAR(k, n) GFSHARE_SPEC_ENTRY(scalar, k, n)
+
+GFSHARE_SPEC_CONFIGS(GFSHARE_SPEC_DEFINE_SCALAR)
+
+const struct gfshare_spec gfshare_spec_scalar[] = {
+  GFSHARE_SPEC_CONFIGS(GFSHARE_SPEC_ENTRY_SCALAR)
+  { 0 }
+};
+
+#ifdef CONFIG_X86_64
+
+#define GFSHARE_SPEC_DEFINE_AVX2(k, n) GFSHARE_SPEC_DEFINE(avx2, k, n)
+#define GFSHARE_SPEC_ENTRY_AVX2(k, n) GFSHARE_SPEC_ENTRY(avx2, k, n)
+
+GFSHARE_SPEC_CONFIGS(GFSHARE_SPEC_DEFINE_AVX2)
+
+const struct gfshare_spec gfshare_spec_avx2[] = {
+  GFSHARE_SPEC_CONFIGS(GFSHARE_SPEC_ENTRY_AVX2)
+  { 0 }
+};
+
+#endif /* CONFIG_X86_64 */
+
+gfshare_spec_enc_t gfshare_spec_find_enc(uint32_t threshold, uint32_t sharecount)
+{
+  const struct gfshare_spec* spec;
+
+  for(spec = gfshare_spec_table; spec && spec->threshold; spec++) {
+    if(spec->threshold == threshold && spec->sharecount == sharecount) {
+      return spec->enc;
+    }
+  }
+  return NULL;
+}
+
+gfshare_spec_dec_t gfshare_spec_find_dec(uint32_t threshold)
+{
+  const struct gfshare_spec* spec;
+
+  for(spec = gfshare_spec_table; spec && spec->threshold; spec++) {
+    if(spec->threshold == threshold) {
+      return spec->dec;
+    }
+  }
+  return NULL;
+}
+
+#define GFSHARE_SPEC_TEST_LEN 103 /* 3 AVX2 blocks and a tail */
+
+/* Too big for the stack together, so allocated once for all the tests */
+struct gfshare_spec_scratch {
+  uint8_t coeffs[GFSHARE_SPEC_MAX_SHARES * GFSHARE_SPEC_TEST_LEN];
+  uint8_t want[GFSHARE_SPEC_TEST_LEN];
+  uint8_t got[GFSHARE_SPEC_MAX_SHARES][GFSHARE_SPEC_TEST_LEN];
+  uint8_t tbl[GFSHARE_SPEC_MAX_SHARES][32];
+  uint8_t row[256];
+};
+
+/* Check one pair's kernels against the scalar engine */
+static int _gfshare_spec_selftest(const struct gfshare_spec* spec,
+                                  struct gfshare_spec_scratch* t)
+{
+  const uint32_t len = GFSHARE_SPEC_TEST_LEN;
+  uint8_t *coeffs = t->coeffs, *want = t->want, *row = t->row;
+  uint8_t (*got)[GFSHARE_SPEC_TEST_LEN] = t->got;
+  uint8_t (*tbl)[32] = t->tbl;
+  uint8_t* shares[GFSHARE_SPEC_MAX_SHARES];
+  const uint8_t* in[GFSHARE_SPEC_MAX_SHARES];
+  uint32_t i, j, c;
+
+  for(i = 0; i < sizeof(t->coeffs); i++) {
+    coeffs[i] = i * 167 + 13;
+  }
+  for(j = 0; j < spec->sharecount; j++) {
+    gfshare_gf_nibbles(j * 37 + 2, tbl[j]);
+    shares[j] = got[j];
+  }
+
+  /* secret is the last row, coefficient c the c'th */
+  spec->enc(shares, coeffs, len, coeffs + (spec->threshold - 1) * len,
+            (const uint8_t (*)[32])tbl, 0, len);
+  for(j = 0; j < spec->sharecount; j++) {
+    memcpy(want, coeffs, len);
+    for(c = 1; c < spec->threshold; c++) {
+      gfshare_gf_scalar.mul_xor(want, want, coeffs + c * len, j * 37 + 2, len);
+    }
+    if(memcmp(want, got[j], len)) {
+      return 1;
+    }
+  }
+
+  memset(want, 0, len);
+  for(j = 0; j < spec->threshold; j++) {
+    in[j] = coeffs + j * len;
+    gfshare_gf_row(j * 37 + 2, row);
+    gfshare_gf_scalar.mul_xor_row(want, in[j], want, row, len);
+  }
+  spec->dec(got[0], in, (const uint8_t (*)[32])tbl, len);
+  return memcmp(want, got[0], len) != 0;
+}
+
+/* Use the current engine's kernels if every one of them checks out */
+void gfshare_spec_init(void)
+{
+#define GFSHARE_SPEC_CHECK(k, n) \
+  BUILD_BUG_ON((k) < 2 || (k) > (n) || (n) > GFSHARE_SPEC_MAX_SHARES);
+  GFSHARE_SPEC_CONFIGS(GFSHARE_SPEC_CHECK)
+#undef GFSHARE_SPEC_CHECK
+  struct gfshare_spec_scratch* scratch;
+  const struct gfshare_spec* spec;
+
+  gfshare_spec_table = NULL;
+  if(gfshare_gf->spec == NULL) {
+    return;
+  }
+  scratch = kmalloc(sizeof(*scratch), GFP_KERNEL);
+  if(scratch == NULL) {
+    printk(KERN_WARNING "gfshare: no memory to test specialised kernels, "
+           "using generic loops\n");
+    return;
+  }
+  for(spec = gfshare_gf->spec; spec->threshold; spec++) {
+    if(_gfshare_spec_selftest(spec, scratch)) {
+      printk(KERN_WARNING "gfshare: %s %u-of-%u kernel failed self-test, "
+             "using generic loops\n", gfshare_gf->name, spec->threshold,
+             spec->sharecount);
+      kfree(scratch);
+      return;
+    }
+  }
+  kfree(scratch);
+  gfshare_spec_table = gfshare_gf->spec;
+  printk(KERN_INFO "gfshare: specialised %s kernels enabled\n", gfshare_gf->name);
+}
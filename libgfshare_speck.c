@@ -0,0 +1,254 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Speck-128/128 in counter mode, used to stretch a 128 bit seed into the
+ * random polynomial coefficients.
+ * The cipher is from https://eprint.iacr.org/2013/404
+ */
+
+#include "libgfshare_internal.h"
+
+#include <linux/kernel.h>
+#include <linux/string.h>
+
+#ifdef CONFIG_X86_64
+#include <asm/fpu/api.h>
+#include <asm/simd.h>
+#endif
+
+#define BLOCK_SIZE 16
+
+#define ROR(x, r) ((x >> r) | (x << (64 - r)))
+#define ROL(x, r) ((x << r) | (x >> (64 - r)))
+#define R(x, y, k) (x = ROR(x, 8), x += y, x ^= k, y = ROL(y, 3), y ^= x)
+
+/* Counters encrypted per pass; the AVX2 path keeps two ymm pairs in flight */
+#define SPECK_LANES 8
+
+/* Bytes of keystream generated per kernel_fpu_begin() section */
+#define SPECK_FPU_CHUNK 4096
+
+static int speck_use_avx2;
+
+/**
+ * Expand a 128 bit key into the round keys. The schedule is the same
+ * R() the rounds use, run over the key words with the round number as key.
+ */
+void gfshare_speck_setkey(struct gfshare_speck_ctx *ctx, const uint8_t key[16])
+{
+    uint64_t b, a;
+    int i;
+
+    memcpy(&b, key, 8);
+    memcpy(&a, key + 8, 8);
+
+    ctx->rk[0] = b;
+    for (i = 0; i < SPECK_ROUNDS - 1; i++) {
+        R(a, b, i);
+        ctx->rk[i + 1] = b;
+    }
+}
+
+/**
+ * pt: plaintext
+ * ct: ciphertext
+ * we assume that input arrays are of length 2 so we get 128 bits
+ */
+void gfshare_speck_encrypt(const struct gfshare_speck_ctx *ctx,
+                           uint64_t ct[2], uint64_t const pt[2])
+{
+    uint64_t y = pt[0], x = pt[1];
+    int i;
+
+    for (i = 0; i < SPECK_ROUNDS; i++)
+        R(x, y, ctx->rk[i]);
+
+    ct[0] = y;
+    ct[1] = x;
+}
+
+/**
+ * Encrypt SPECK_LANES blocks held as separate x (high) and y (low) word
+ * arrays, in place. Interleaving independent blocks lets the CPU overlap
+ * their dependency chains even without vector registers.
+ */
+static void speck_encrypt_lanes_scalar(const struct gfshare_speck_ctx *ctx,
+                                       uint64_t *x, uint64_t *y)
+{
+    int i, l;
+
+    for (i = 0; i < SPECK_ROUNDS; i++) {
+        for (l = 0; l < SPECK_LANES; l++)
+            R(x[l], y[l], ctx->rk[i]);
+    }
+}
+
+#ifdef CONFIG_X86_64
+
+/* vpshufb pattern rotating every 64 bit lane right by 8 bits */
+static const uint8_t speck_ror8[32] __aligned(32) = {
+    1, 2, 3, 4, 5, 6, 7, 0, 9, 10, 11, 12, 13, 14, 15, 8,
+    1, 2, 3, 4, 5, 6, 7, 0, 9, 10, 11, 12, 13, 14, 15, 8 };
+
+/**
+ * As speck_encrypt_lanes_scalar, with four blocks per ymm register.
+ * Must be called between kernel_fpu_begin() and kernel_fpu_end().
+ */
+static void speck_encrypt_lanes_avx2(const struct gfshare_speck_ctx *ctx,
+                                     uint64_t *x, uint64_t *y)
+{
+    const uint64_t *rk = ctx->rk;
+    const uint64_t *end = ctx->rk + SPECK_ROUNDS;
+
+    asm volatile(
+        "vmovdqu        %[ror8], %%ymm7\n\t"
+        "vmovdqu        (%[x]), %%ymm0\n\t"
+        "vmovdqu        (%[y]), %%ymm1\n\t"
+        "vmovdqu        32(%[x]), %%ymm2\n\t"
+        "vmovdqu        32(%[y]), %%ymm3\n\t"
+        "1:\n\t"
+        "vpbroadcastq   (%[rk]), %%ymm6\n\t"
+        "vpshufb        %%ymm7, %%ymm0, %%ymm0\n\t"
+        "vpshufb        %%ymm7, %%ymm2, %%ymm2\n\t"
+        "vpaddq         %%ymm1, %%ymm0, %%ymm0\n\t"
+        "vpaddq         %%ymm3, %%ymm2, %%ymm2\n\t"
+        "vpxor          %%ymm6, %%ymm0, %%ymm0\n\t"
+        "vpxor          %%ymm6, %%ymm2, %%ymm2\n\t"
+        "vpsllq         $3, %%ymm1, %%ymm4\n\t"
+        "vpsllq         $3, %%ymm3, %%ymm5\n\t"
+        "vpsrlq         $61, %%ymm1, %%ymm1\n\t"
+        "vpsrlq         $61, %%ymm3, %%ymm3\n\t"
+        "vpor           %%ymm4, %%ymm1, %%ymm1\n\t"
+        "vpor           %%ymm5, %%ymm3, %%ymm3\n\t"
+        "vpxor          %%ymm0, %%ymm1, %%ymm1\n\t"
+        "vpxor          %%ymm2, %%ymm3, %%ymm3\n\t"
+        "add            $8, %[rk]\n\t"
+        "cmp            %[end], %[rk]\n\t"
+        "jb             1b\n\t"
+        "vmovdqu        %%ymm0, (%[x])\n\t"
+        "vmovdqu        %%ymm1, (%[y])\n\t"
+        "vmovdqu        %%ymm2, 32(%[x])\n\t"
+        "vmovdqu        %%ymm3, 32(%[y])\n\t"
+        "vzeroupper\n\t"
+        : [rk] "+r" (rk)
+        : [x] "r" (x), [y] "r" (y), [end] "r" (end),
+          [ror8] "m" (speck_ror8)
+        : "memory", "cc");
+}
+
+#endif /* CONFIG_X86_64 */
+
+static inline void speck_ctr_inc(uint64_t ctr[2])
+{
+    if (++ctr[0] == 0)
+        ctr[1]++;
+}
+
+/**
+ * Fill whole SPECK_LANES block groups of keystream. Returns the number of
+ * bytes written, a multiple of SPECK_LANES * BLOCK_SIZE.
+ */
+static size_t speck_ctr_lanes(const struct gfshare_speck_ctx *ctx,
+                              uint64_t ctr[2], uint8_t *out, size_t len)
+{
+    uint64_t x[SPECK_LANES], y[SPECK_LANES];
+    size_t done = 0, stop;
+    int l, simd = 0;
+
+    while (len - done >= SPECK_LANES * BLOCK_SIZE) {
+#ifdef CONFIG_X86_64
+        simd = speck_use_avx2 && may_use_simd();
+        if (simd)
+            kernel_fpu_begin();
+#endif
+        stop = done + min_t(size_t, len - done, SPECK_FPU_CHUNK);
+        while (stop - done >= SPECK_LANES * BLOCK_SIZE) {
+            for (l = 0; l < SPECK_LANES; l++) {
+                y[l] = ctr[0];
+                x[l] = ctr[1];
+                speck_ctr_inc(ctr);
+            }
+#ifdef CONFIG_X86_64
+            if (simd)
+                speck_encrypt_lanes_avx2(ctx, x, y);
+            else
+#endif
+                speck_encrypt_lanes_scalar(ctx, x, y);
+            for (l = 0; l < SPECK_LANES; l++) {
+                memcpy(out + done, &y[l], 8);
+                memcpy(out + done + 8, &x[l], 8);
+                done += BLOCK_SIZE;
+            }
+        }
+#ifdef CONFIG_X86_64
+        if (simd)
+            kernel_fpu_end();
+#endif
+    }
+    return done;
+}
+
+/**
+ * Write len bytes of keystream starting at block 'ctr', and advance ctr
+ * past the last block used. len need not be a multiple of the block size;
+ * a partial final block is truncated.
+ */
+void gfshare_speck_ctr(const struct gfshare_speck_ctx *ctx, uint64_t ctr[2],
+                       uint8_t *out, size_t len)
+{
+    uint64_t block[2];
+    size_t done;
+
+    done = speck_ctr_lanes(ctx, ctr, out, len);
+    while (done < len) {
+        gfshare_speck_encrypt(ctx, block, ctr);
+        speck_ctr_inc(ctr);
+        memcpy(out + done, block, min_t(size_t, len - done, BLOCK_SIZE));
+        done += min_t(size_t, len - done, BLOCK_SIZE);
+    }
+    memzero_explicit(block, sizeof(block));
+}
+
+/**
+ * output_length: size of the output block
+ * output_block: destination for pseudorandom bits
+ * seed: a 128 bit random number
+ * Generate a block of random bytes given a key (seed) by running speck in
+ * counter mode from a zero counter.
+ */
+void generate_block_ctr(size_t output_length, uint8_t *output_block, uint8_t *seed)
+{
+    struct gfshare_speck_ctx ctx;
+    uint64_t ctr[2] = { 0, 0 };
+
+    gfshare_speck_setkey(&ctx, seed);
+    gfshare_speck_ctr(&ctx, ctr, output_block, output_length);
+    memzero_explicit(&ctx, sizeof(ctx));
+}
+
+void gfshare_speck_init(void)
+{
+    speck_use_avx2 = gfshare_cpu_has_avx2();
+}
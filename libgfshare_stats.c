@@ -0,0 +1,220 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Phase timing for the gfshare tracepoints and per-CPU latency histograms.
+ *
+ * Nothing is measured until the timing key is switched on, either by
+ * enabling one of the gfshare trace events or by writing 1 to
+ * <debugfs>/gfshare/enable. Each timed phase then bumps its count, byte and
+ * nanosecond totals and one log2 latency bucket in this CPU's statistics,
+ * and fires its tracepoint. <debugfs>/gfshare/stats sums the CPUs; writing
+ * to <debugfs>/gfshare/reset zeroes them.
+ */
+
+#include "libgfshare_internal.h"
+
+#include <linux/bitops.h>
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/jump_label.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+#include <linux/timekeeping.h>
+
+#define CREATE_TRACE_POINTS
+#include "libgfshare_trace.h"
+
+/* Bucket b counts phases that took [2^(b-1), 2^b) ns; the last is open */
+#define GFSHARE_HIST_BUCKETS 40
+
+struct gfshare_stat_cpu {
+    uint64_t count[GFSHARE_STAT_NR];
+    uint64_t bytes[GFSHARE_STAT_NR];
+    uint64_t ns[GFSHARE_STAT_NR];
+    uint64_t hist[GFSHARE_STAT_NR][GFSHARE_HIST_BUCKETS];
+};
+
+static DEFINE_PER_CPU(struct gfshare_stat_cpu, gfshare_stat_cpus);
+
+static const char *const gfshare_stat_names[GFSHARE_STAT_NR] = {
+    [GFSHARE_STAT_RAND] = "rand_fill",
+    [GFSHARE_STAT_ENC_EVAL] = "enc_eval",
+    [GFSHARE_STAT_ENC_SHARE] = "enc_share",
+    [GFSHARE_STAT_DEC_INTERP] = "dec_interp",
+};
+
+DEFINE_STATIC_KEY_FALSE(gfshare_timing_key);
+
+static DEFINE_MUTEX(gfshare_stats_lock);
+static bool gfshare_stats_enabled;
+static struct dentry *gfshare_debugfs;
+
+/* Account one timed phase to this CPU and return how long it took */
+static uint64_t gfshare_stat_account(enum gfshare_stat stat, uint64_t start,
+                                     size_t bytes)
+{
+    uint64_t ns = ktime_get_ns() - start;
+    unsigned int bucket = min_t(unsigned int, fls64(ns), GFSHARE_HIST_BUCKETS - 1);
+
+    this_cpu_inc(gfshare_stat_cpus.count[stat]);
+    this_cpu_add(gfshare_stat_cpus.bytes[stat], bytes);
+    this_cpu_add(gfshare_stat_cpus.ns[stat], ns);
+    this_cpu_inc(gfshare_stat_cpus.hist[stat][bucket]);
+    return ns;
+}
+
+void _gfshare_stat_record(enum gfshare_stat stat, uint64_t start, size_t bytes)
+{
+    uint64_t ns = gfshare_stat_account(stat, start, bytes);
+
+    switch (stat) {
+    case GFSHARE_STAT_RAND:
+        trace_gfshare_rand_fill(bytes, ns);
+        break;
+    case GFSHARE_STAT_ENC_EVAL:
+        trace_gfshare_enc_eval(bytes, ns);
+        break;
+    case GFSHARE_STAT_DEC_INTERP:
+        trace_gfshare_dec_interp(bytes, ns);
+        break;
+    default:
+        break;
+    }
+}
+
+void _gfshare_stat_record_share(uint8_t sharenr, uint64_t start, size_t bytes)
+{
+    uint64_t ns = gfshare_stat_account(GFSHARE_STAT_ENC_SHARE, start, bytes);
+
+    trace_gfshare_enc_share(sharenr, bytes, ns);
+}
+
+int gfshare_trace_reg(void)
+{
+    static_branch_inc(&gfshare_timing_key);
+    return 0;
+}
+
+void gfshare_trace_unreg(void)
+{
+    static_branch_dec(&gfshare_timing_key);
+}
+
+/* ---------------------------------------------------------[ debugfs ]---- */
+
+static int gfshare_stats_show(struct seq_file *m, void *v)
+{
+    struct gfshare_stat_cpu *sc;
+    uint64_t count, bytes, ns, hist[GFSHARE_HIST_BUCKETS];
+    int cpu, stat, b;
+
+    for (stat = 0; stat < GFSHARE_STAT_NR; stat++) {
+        count = bytes = ns = 0;
+        memset(hist, 0, sizeof(hist));
+        for_each_possible_cpu(cpu) {
+            sc = per_cpu_ptr(&gfshare_stat_cpus, cpu);
+            count += READ_ONCE(sc->count[stat]);
+            bytes += READ_ONCE(sc->bytes[stat]);
+            ns += READ_ONCE(sc->ns[stat]);
+            for (b = 0; b < GFSHARE_HIST_BUCKETS; b++)
+                hist[b] += READ_ONCE(sc->hist[stat][b]);
+        }
+
+        seq_printf(m, "%s: count %llu bytes %llu ns %llu\n",
+                   gfshare_stat_names[stat], (unsigned long long)count,
+                   (unsigned long long)bytes, (unsigned long long)ns);
+        for (b = 0; b < GFSHARE_HIST_BUCKETS; b++) {
+            if (!hist[b])
+                continue;
+            if (b == GFSHARE_HIST_BUCKETS - 1)
+                seq_printf(m, "  >= %llu ns: %llu\n",
+                           1ULL << (b - 1), (unsigned long long)hist[b]);
+            else
+                seq_printf(m, "  < %llu ns: %llu\n",
+                           1ULL << b, (unsigned long long)hist[b]);
+        }
+    }
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(gfshare_stats);
+
+static ssize_t gfshare_stats_reset_write(struct file *file, const char __user *buf,
+                                         size_t count, loff_t *ppos)
+{
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+        memset(per_cpu_ptr(&gfshare_stat_cpus, cpu), 0,
+               sizeof(struct gfshare_stat_cpu));
+    return count;
+}
+
+static const struct file_operations gfshare_stats_reset_fops = {
+    .owner = THIS_MODULE,
+    .write = gfshare_stats_reset_write,
+    .llseek = noop_llseek,
+};
+
+static int gfshare_stats_enable_get(void *data, u64 *val)
+{
+    *val = gfshare_stats_enabled;
+    return 0;
+}
+
+static int gfshare_stats_enable_set(void *data, u64 val)
+{
+    mutex_lock(&gfshare_stats_lock);
+    if (val && !gfshare_stats_enabled)
+        static_branch_inc(&gfshare_timing_key);
+    else if (!val && gfshare_stats_enabled)
+        static_branch_dec(&gfshare_timing_key);
+    gfshare_stats_enabled = !!val;
+    mutex_unlock(&gfshare_stats_lock);
+    return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(gfshare_stats_enable_fops, gfshare_stats_enable_get,
+                         gfshare_stats_enable_set, "%llu\n");
+
+/* debugfs is best effort; the library works the same without it */
+void gfshare_stats_init(void)
+{
+    gfshare_debugfs = debugfs_create_dir("gfshare", NULL);
+    debugfs_create_file_unsafe("enable", 0600, gfshare_debugfs, NULL,
+                               &gfshare_stats_enable_fops);
+    debugfs_create_file("stats", 0400, gfshare_debugfs, NULL, &gfshare_stats_fops);
+    debugfs_create_file("reset", 0200, gfshare_debugfs, NULL,
+                        &gfshare_stats_reset_fops);
+}
+
+void gfshare_stats_exit(void)
+{
+    debugfs_remove_recursive(gfshare_debugfs);
+    gfshare_debugfs = NULL;
+    gfshare_stats_enable_set(NULL, 0);
+}
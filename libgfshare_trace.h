@@ -0,0 +1,107 @@
+/*
+ * This file is Copyright Daniel Silverstone <dsilvers@digital-scurf.org> 2006
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Static tracepoints on the split and combine phases. Each event carries the
+ * bytes processed and how long the phase took; the timing is only taken
+ * while an event (or the debugfs histograms) is enabled.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM gfshare
+
+#if !defined(_GFSHARE_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _GFSHARE_TRACE_H
+
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(gfshare_phase,
+
+    TP_PROTO(size_t bytes, uint64_t ns),
+
+    TP_ARGS(bytes, ns),
+
+    TP_STRUCT__entry(
+        __field(size_t, bytes)
+        __field(uint64_t, ns)
+    ),
+
+    TP_fast_assign(
+        __entry->bytes = bytes;
+        __entry->ns = ns;
+    ),
+
+    TP_printk("bytes=%zu ns=%llu", __entry->bytes,
+              (unsigned long long)__entry->ns)
+);
+
+/* Random coefficient fill */
+DEFINE_EVENT_FN(gfshare_phase, gfshare_rand_fill,
+    TP_PROTO(size_t bytes, uint64_t ns),
+    TP_ARGS(bytes, ns),
+    gfshare_trace_reg, gfshare_trace_unreg);
+
+/* Polynomial evaluation of a byte range for every share */
+DEFINE_EVENT_FN(gfshare_phase, gfshare_enc_eval,
+    TP_PROTO(size_t bytes, uint64_t ns),
+    TP_ARGS(bytes, ns),
+    gfshare_trace_reg, gfshare_trace_unreg);
+
+/* Evaluation of one share over one tile of that range */
+TRACE_EVENT_FN(gfshare_enc_share,
+
+    TP_PROTO(uint8_t sharenr, size_t bytes, uint64_t ns),
+
+    TP_ARGS(sharenr, bytes, ns),
+
+    TP_STRUCT__entry(
+        __field(uint8_t, sharenr)
+        __field(size_t, bytes)
+        __field(uint64_t, ns)
+    ),
+
+    TP_fast_assign(
+        __entry->sharenr = sharenr;
+        __entry->bytes = bytes;
+        __entry->ns = ns;
+    ),
+
+    TP_printk("sharenr=%u bytes=%zu ns=%llu", __entry->sharenr,
+              __entry->bytes, (unsigned long long)__entry->ns),
+
+    gfshare_trace_reg, gfshare_trace_unreg);
+
+/* Lagrange interpolation of a byte range of the secret */
+DEFINE_EVENT_FN(gfshare_phase, gfshare_dec_interp,
+    TP_PROTO(size_t bytes, uint64_t ns),
+    TP_ARGS(bytes, ns),
+    gfshare_trace_reg, gfshare_trace_unreg);
+
+#endif /* _GFSHARE_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE libgfshare_trace
+#include <trace/define_trace.h>
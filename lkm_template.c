@@ -17,13 +17,20 @@ static int __init km_template_init(void){
     uint8_t* recombine = kmalloc(SECRET_SIZE, GFP_KERNEL);
     uint8_t** shards = kmalloc(sizeof(uint8_t*) * 3, GFP_KERNEL);
     uint8_t* sharenrs = "012";
-    int i;
+    int i, ret;
     uint64_t time = 0;
 
     gfshare_ctx *G;
     gfshare_ctx *G_dec;
 
     printk(KERN_INFO "Inserting kernel module\n");
+    ret = gfshare_init();
+    if(ret){
+        kfree(secret);
+        kfree(recombine);
+        kfree(shards);
+        return ret;
+    }
     for(i = 0; i < 3; i++){
         shards[i] = kmalloc(SECRET_SIZE, GFP_KERNEL);
     }
@@ -65,11 +72,19 @@ exit:
     kfree(shards[1]);
     kfree(shards[2]);
     //kfree(shards);
-    return 0;
+
+    ret = gfshare_dev_init();
+    if(ret){
+        printk(KERN_ERR "Registering /dev/gfshare failed: %d\n", ret);
+        gfshare_exit();
+    }
+    return ret;
 }
 
 static void __exit km_template_exit(void){
     printk(KERN_INFO "Removing kernel module\n");
+    gfshare_dev_exit();
+    gfshare_exit();
 }
 
 module_init(km_template_init);
@@ -0,0 +1,246 @@
+/*
+ * Throughput of the libgfshare core in userspace.
+ *
+ * For every (size, threshold, sharecount) point this times three things
+ * separately: filling the (threshold - 1) * size random coefficient bytes a
+ * split needs, a whole gfshare_ctx_enc_getshares, and a combine of
+ * threshold shares (giveshare plus extract). GB/s is secret bytes per
+ * second except for the random fill, where it is random bytes per second.
+ * Every point is checked to round-trip before it is timed.
+ *
+ *   gfshare_bench [-s size] [-k threshold -n sharecount] [-t ms] [-e engine]
+ *
+ * Without options the built-in sweep is run. -e runs the split and combine
+ * contexts on the named GF(256) engine instead of the default one. Set
+ * GFSHARE_LOGLEVEL=6 to see the library's informational messages.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libgfshare.h"
+
+static const size_t bench_sizes[] = {
+    64, 512, 4096, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024,
+};
+
+static const struct {
+    uint32_t threshold;
+    uint32_t sharecount;
+} bench_configs[] = {
+    { 2, 3 }, { 3, 5 }, { 4, 6 }, { 5, 12 },
+};
+
+enum bench_op { OP_RAND, OP_SPLIT, OP_COMBINE };
+
+static const char *const bench_op_names[] = { "rand", "split", "combine" };
+
+struct bench_point {
+    size_t size;
+    uint32_t threshold;
+    uint32_t sharecount;
+    uint8_t sharenrs[255];
+    uint8_t *secret;
+    uint8_t *recombined;
+    uint8_t *randbuf;
+    uint8_t **shares;
+    gfshare_ctx *enc;
+    gfshare_ctx *dec;
+};
+
+static uint64_t min_ns = 200 * 1000000ull;
+static const char *engine;
+
+static uint64_t now_ns(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+static void combine(struct bench_point *p)
+{
+    uint32_t i;
+
+    for (i = 0; i < p->threshold; i++)
+        gfshare_ctx_dec_giveshare(p->dec, i, p->shares[i]);
+    gfshare_ctx_dec_extract(p->dec, p->recombined);
+}
+
+static void run_op(struct bench_point *p, enum bench_op op)
+{
+    switch (op) {
+    case OP_RAND:
+        gfshare_fill_rand(p->randbuf, (size_t)(p->threshold - 1) * p->size);
+        break;
+    case OP_SPLIT:
+        gfshare_ctx_enc_getshares(p->enc, p->secret, p->shares);
+        break;
+    case OP_COMBINE:
+        combine(p);
+        break;
+    }
+}
+
+/* Double the iteration count until one batch takes at least min_ns */
+static void time_op(struct bench_point *p, enum bench_op op)
+{
+    uint64_t iters = 1, i, start, ns;
+    double bytes;
+
+    run_op(p, op);
+    for (;;) {
+        start = now_ns();
+        for (i = 0; i < iters; i++)
+            run_op(p, op);
+        ns = now_ns() - start;
+        if (ns >= min_ns || iters >= (1ull << 40))
+            break;
+        iters *= ns * 2 < min_ns ? 4 : 2;
+    }
+
+    bytes = (double)p->size * iters;
+    if (op == OP_RAND)
+        bytes *= p->threshold - 1;
+    printf("%10zu %3u %3u  %-8s %14.1f %10.3f\n", p->size, p->threshold,
+           p->sharecount, bench_op_names[op], (double)ns / iters, bytes / ns);
+}
+
+static void free_point(struct bench_point *p)
+{
+    uint32_t i;
+
+    if (p->enc)
+        gfshare_ctx_free(p->enc);
+    if (p->dec)
+        gfshare_ctx_free(p->dec);
+    if (p->shares) {
+        for (i = 0; i < p->sharecount; i++)
+            free(p->shares[i]);
+    }
+    free(p->shares);
+    free(p->secret);
+    free(p->recombined);
+    free(p->randbuf);
+}
+
+static int bench_point(size_t size, uint32_t threshold, uint32_t sharecount)
+{
+    struct bench_point p = { size, threshold, sharecount };
+    size_t i;
+    int ret = 1;
+
+    for (i = 0; i < sharecount; i++)
+        p.sharenrs[i] = i + 1;
+
+    p.secret = malloc(size);
+    p.recombined = malloc(size);
+    p.randbuf = malloc((threshold - 1) * size);
+    p.shares = calloc(sharecount, sizeof(*p.shares));
+    if (!p.secret || !p.recombined || !p.randbuf || !p.shares)
+        goto out;
+    for (i = 0; i < sharecount; i++) {
+        p.shares[i] = malloc(size);
+        if (!p.shares[i])
+            goto out;
+    }
+
+    /* The decoder only sees the first 'threshold' shares */
+    p.enc = gfshare_ctx_init_enc(p.sharenrs, sharecount, threshold, size);
+    p.dec = gfshare_ctx_init_dec(p.sharenrs, threshold, threshold, size);
+    if (!p.enc || !p.dec)
+        goto out;
+    gfshare_ctx_set_parallel(p.enc, 1);
+    gfshare_ctx_set_parallel(p.dec, 1);
+    if (engine && (gfshare_ctx_set_engine(p.enc, engine) ||
+                   gfshare_ctx_set_engine(p.dec, engine))) {
+        fprintf(stderr, "gfshare_bench: no GF(256) engine '%s'\n", engine);
+        goto out;
+    }
+
+    for (i = 0; i < size; i++)
+        p.secret[i] = rand();
+    gfshare_ctx_enc_getshares(p.enc, p.secret, p.shares);
+    combine(&p);
+    if (memcmp(p.secret, p.recombined, size)) {
+        fprintf(stderr, "gfshare_bench: %zu byte %u-of-%u round trip failed\n",
+                size, threshold, sharecount);
+        goto out;
+    }
+
+    time_op(&p, OP_RAND);
+    time_op(&p, OP_SPLIT);
+    time_op(&p, OP_COMBINE);
+    ret = 0;
+out:
+    if (ret && !p.enc)
+        fprintf(stderr, "gfshare_bench: can't set up %zu byte %u-of-%u\n",
+                size, threshold, sharecount);
+    free_point(&p);
+    return ret;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: gfshare_bench [-s size] [-k threshold -n sharecount] [-t ms] [-e engine]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    size_t size = 0, s, c;
+    uint32_t threshold = 0, sharecount = 0;
+    int opt, ret = 0;
+
+    while ((opt = getopt(argc, argv, "s:k:n:t:e:")) != -1) {
+        switch (opt) {
+        case 's':
+            size = strtoull(optarg, NULL, 0);
+            break;
+        case 'k':
+            threshold = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            sharecount = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            min_ns = strtoull(optarg, NULL, 0) * 1000000ull;
+            break;
+        case 'e':
+            engine = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc || !threshold != !sharecount)
+        usage();
+    if (threshold && (threshold < 2 || threshold > sharecount || sharecount > 255))
+        usage();
+
+    if (gfshare_init()) {
+        fprintf(stderr, "gfshare_bench: gfshare_init failed\n");
+        return 1;
+    }
+
+    printf("%10s %3s %3s  %-8s %14s %10s\n",
+           "size", "k", "n", "op", "ns/op", "GB/s");
+    for (s = 0; s < sizeof(bench_sizes) / sizeof(bench_sizes[0]); s++) {
+        if (size && s)
+            break;
+        for (c = 0; c < sizeof(bench_configs) / sizeof(bench_configs[0]); c++) {
+            if (threshold && c)
+                break;
+            ret |= bench_point(size ? size : bench_sizes[s],
+                               threshold ? threshold : bench_configs[c].threshold,
+                               sharecount ? sharecount : bench_configs[c].sharecount);
+        }
+    }
+
+    gfshare_exit();
+    return ret;
+}
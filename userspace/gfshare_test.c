@@ -0,0 +1,759 @@
+/*
+ * Round-trip tests of the libgfshare core in userspace.
+ *
+ * Every entry point is driven through a split and a recombination of
+ * random secrets, and the result compared with the original: plain,
+ * borrowed, pooled, batch, stream, scatterlist, range, ramp, hybrid,
+ * repair, refresh, error correction, GF(2^16) and async. Shares made by
+ * one GF(256) engine (or the specialised kernels) are recombined by the
+ * others. The last test calls what must be refused on the wrong kind of
+ * context and checks that it returns 1 rather than crash.
+ *
+ *   gfshare_test [test]
+ *
+ * Without an argument every test is run. Exits nonzero if any fails.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/scatterlist.h>
+#include <linux/slab.h>
+
+#include "libgfshare.h"
+
+#define MAX_SHARES 16
+
+static const size_t test_sizes[] = { 1, 63, 64, 65, 4099, 70000 };
+
+static const struct {
+    uint32_t threshold;
+    uint32_t sharecount;
+} test_configs[] = {
+    { 1, 3 }, { 2, 3 }, { 3, 5 }, { 4, 6 }, { 5, 12 }, { 7, 16 },
+};
+
+static int failures;
+
+#define CHECK(cond, ...)                                        \
+    do {                                                        \
+        if (!(cond)) {                                          \
+            fprintf(stderr, "gfshare_test: %s:%d: ", __func__,  \
+                    __LINE__);                                  \
+            fprintf(stderr, __VA_ARGS__);                       \
+            fputc('\n', stderr);                                \
+            failures++;                                         \
+            return;                                             \
+        }                                                       \
+    } while (0)
+
+/* One secret and room for its shares and a recombined copy */
+struct test_set {
+    size_t size;
+    uint32_t threshold;
+    uint32_t sharecount;
+    uint8_t sharenrs[MAX_SHARES];
+    uint8_t present[MAX_SHARES];  /* sharenrs with all but 'threshold' zeroed */
+    uint8_t *secret;
+    uint8_t *out;
+    uint8_t *shares[MAX_SHARES];
+};
+
+static void fill_random(uint8_t *buf, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        buf[i] = rand();
+}
+
+static void set_init(struct test_set *t, size_t size, uint32_t threshold,
+                     uint32_t sharecount)
+{
+    uint32_t i, have;
+
+    t->size = size;
+    t->threshold = threshold;
+    t->sharecount = sharecount;
+    for (i = 0; i < sharecount; i++)
+        t->sharenrs[i] = i * 37 + 1;
+    memcpy(t->present, t->sharenrs, sharecount);
+    for (have = sharecount; have > threshold; ) {
+        i = rand() % sharecount;
+        if (t->present[i]) {
+            t->present[i] = 0;
+            have--;
+        }
+    }
+    t->secret = malloc(size);
+    t->out = malloc(size);
+    fill_random(t->secret, size);
+    for (i = 0; i < sharecount; i++)
+        t->shares[i] = malloc(size + 16);
+}
+
+static void set_free(struct test_set *t)
+{
+    uint32_t i;
+
+    for (i = 0; i < t->sharecount; i++)
+        free(t->shares[i]);
+    free(t->secret);
+    free(t->out);
+}
+
+/* Give the present shares to 'dec' and extract into t->out */
+static void set_combine(struct test_set *t, gfshare_ctx *dec)
+{
+    uint32_t i;
+
+    memset(t->out, 0, t->size);
+    gfshare_ctx_dec_newshares(dec, t->present);
+    for (i = 0; i < t->sharecount; i++) {
+        if (t->present[i])
+            gfshare_ctx_dec_giveshare(dec, i, t->shares[i]);
+    }
+    gfshare_ctx_dec_extract(dec, t->out);
+}
+
+/* ---------------------------------------------------------[ plain ]---- */
+
+static void test_plain(void)
+{
+    struct test_set t;
+    gfshare_ctx *enc, *dec;
+    size_t s, c;
+
+    for (s = 0; s < sizeof(test_sizes) / sizeof(test_sizes[0]); s++) {
+        for (c = 0; c < sizeof(test_configs) / sizeof(test_configs[0]); c++) {
+            set_init(&t, test_sizes[s], test_configs[c].threshold,
+                     test_configs[c].sharecount);
+            enc = gfshare_ctx_init_enc(t.sharenrs, t.sharecount, t.threshold, t.size);
+            dec = gfshare_ctx_init_dec(t.sharenrs, t.sharecount, t.threshold, t.size);
+            CHECK(enc && dec, "init %u/%u", t.threshold, t.sharecount);
+            CHECK(!gfshare_ctx_enc_getshares(enc, t.secret, t.shares), "split");
+            set_combine(&t, dec);
+            CHECK(!memcmp(t.out, t.secret, t.size), "size %zu %u/%u", t.size,
+                  t.threshold, t.sharecount);
+            gfshare_ctx_free(enc);
+            gfshare_ctx_free(dec);
+            set_free(&t);
+        }
+    }
+}
+
+/* Every engine, and the specialised kernels the default engine uses for
+ * (2, 3), (3, 5) and (4, 6), must agree: shares from each are recombined
+ * by each other one.
+ */
+static void test_engines(void)
+{
+    static const char *const engines[] = {
+        NULL, "scalar", "bitslice", "ssse3", "avx2",
+    };
+    const size_t n = sizeof(engines) / sizeof(engines[0]);
+    struct test_set t;
+    gfshare_ctx *enc, *dec;
+    size_t c, e, d;
+
+    for (c = 0; c < sizeof(test_configs) / sizeof(test_configs[0]); c++) {
+        set_init(&t, 4099, test_configs[c].threshold, test_configs[c].sharecount);
+        for (e = 0; e < n; e++) {
+            enc = gfshare_ctx_init_enc(t.sharenrs, t.sharecount, t.threshold, t.size);
+            CHECK(enc, "init");
+            if (gfshare_ctx_set_engine(enc, engines[e])) {
+                gfshare_ctx_free(enc);
+                continue;
+            }
+            gfshare_ctx_enc_getshares(enc, t.secret, t.shares);
+            for (d = 0; d < n; d++) {
+                dec = gfshare_ctx_init_dec(t.sharenrs, t.sharecount, t.threshold,
+                                           t.size);
+                CHECK(dec, "init");
+                if (gfshare_ctx_set_engine(dec, engines[d]) == 0) {
+                    set_combine(&t, dec);
+                    CHECK(!memcmp(t.out, t.secret, t.size), "%s -> %s %u/%u",
+                          engines[e] ? engines[e] : "default",
+                          engines[d] ? engines[d] : "default",
+                          t.threshold, t.sharecount);
+                }
+                gfshare_ctx_free(dec);
+            }
+            gfshare_ctx_free(enc);
+        }
+        set_free(&t);
+    }
+}
+
+static void test_borrowed(void)
+{
+    struct test_set t;
+    gfshare_ctx *enc, *dec;
+    uint32_t i;
+
+    set_init(&t, 70000, 3, 5);
+    enc = gfshare_ctx_init_enc(t.sharenrs, t.sharecount, t.threshold, t.size);
+    dec = gfshare_ctx_init_dec_borrowed(t.sharenrs, t.sharecount, t.threshold, t.size);
+    CHECK(enc && dec, "init");
+    gfshare_ctx_enc_getshares(enc, t.secret, t.shares);
+    gfshare_ctx_dec_newshares(dec, t.present);
+    for (i = 0; i < t.sharecount; i++) {
+        if (t.present[i])
+            CHECK(!gfshare_ctx_dec_borrowshare(dec, i, t.shares[i]), "borrow");
+    }
+    gfshare_ctx_dec_extract(dec, t.out);
+    CHECK(!memcmp(t.out, t.secret, t.size), "mismatch");
+    gfshare_ctx_free(enc);
+    gfshare_ctx_free(dec);
+    set_free(&t);
+}
+
+static void test_pooled(void)
+{
+    struct test_set t;
+    gfshare_ctx *enc, *dec;
+    int round;
+
+    for (round = 0; round < 4; round++) {
+        set_init(&t, 1 + rand() % 8000, 3, 5);
+        enc = gfshare_ctx_pool_get_enc(t.sharenrs, t.sharecount, t.threshold,
+                                       t.size, round & 1 ? GFP_ATOMIC : GFP_KERNEL);
+        dec = gfshare_ctx_pool_get_dec(t.sharenrs, t.sharecount, t.threshold,
+                                       t.size, GFP_KERNEL);
+        CHECK(enc && dec, "pool get");
+        gfshare_ctx_enc_getshares(enc, t.secret, t.shares);
+        set_combine(&t, dec);
+        CHECK(!memcmp(t.out, t.secret, t.size), "mismatch, size %zu", t.size);
+        gfshare_ctx_pool_put(enc);
+        gfshare_ctx_free(dec);
+        set_free(&t);
+    }
+}
+
+static void test_batch(void)
+{
+    enum { COUNT = 7 };
+    struct test_set t[COUNT];
+    uint8_t *secrets[COUNT], *outs[COUNT];
+    uint8_t **shares[COUNT];
+    gfshare_ctx *enc, *dec;
+    int j;
+
+    for (j = 0; j < COUNT; j++) {
+        set_init(&t[j], 1000, 3, 5);
+        memcpy(t[j].present, t[0].present, t[0].sharecount);
+        secrets[j] = t[j].secret;
+        outs[j] = t[j].out;
+        shares[j] = t[j].shares;
+    }
+    enc = gfshare_ctx_init_enc(t[0].sharenrs, 5, 3, 1000);
+    dec = gfshare_ctx_init_dec(t[0].sharenrs, 5, 3, 1000);
+    CHECK(enc && dec, "init");
+    CHECK(!gfshare_ctx_enc_getshares_batch(enc, COUNT, secrets, shares), "split");
+    gfshare_ctx_dec_newshares(dec, t[0].present);
+    CHECK(!gfshare_ctx_dec_extract_batch(dec, COUNT, shares, outs), "combine");
+    for (j = 0; j < COUNT; j++)
+        CHECK(!memcmp(t[j].out, t[j].secret, 1000), "secret %d", j);
+    gfshare_ctx_free(enc);
+    gfshare_ctx_free(dec);
+    for (j = 0; j < COUNT; j++)
+        set_free(&t[j]);
+}
+
+static void test_stream(void)
+{
+    const size_t chunk = 1000;
+    const uint8_t *in[MAX_SHARES];
+    uint8_t *out[MAX_SHARES];
+    struct test_set t;
+    gfshare_ctx *enc, *dec;
+    size_t pos, len;
+    uint32_t i;
+
+    set_init(&t, 70000, 4, 6);
+    enc = gfshare_ctx_init_enc(t.sharenrs, t.sharecount, t.threshold, chunk);
+    dec = gfshare_ctx_init_dec(t.sharenrs, t.sharecount, t.threshold, chunk);
+    CHECK(enc && dec, "init");
+    CHECK(!gfshare_ctx_enc_stream_init(enc), "stream init");
+    for (pos = 0; pos < t.size; pos += len) {
+        len = t.size - pos < chunk ? t.size - pos : 1 + rand() % chunk;
+        for (i = 0; i < t.sharecount; i++)
+            out[i] = t.shares[i] + pos;
+        CHECK(!gfshare_ctx_enc_stream_update(enc, t.secret + pos, len, out),
+              "stream update");
+    }
+    gfshare_ctx_enc_stream_final(enc);
+
+    gfshare_ctx_dec_newshares(dec, t.present);
+    for (pos = 0; pos < t.size; pos += len) {
+        len = t.size - pos < chunk ? t.size - pos : chunk;
+        for (i = 0; i < t.sharecount; i++)
+            in[i] = t.present[i] ? t.shares[i] + pos : NULL;
+        CHECK(!gfshare_ctx_dec_stream_update(dec, in, len, t.out + pos),
+              "dec stream update");
+    }
+    CHECK(!memcmp(t.out, t.secret, t.size), "mismatch");
+    gfshare_ctx_free(enc);
+    gfshare_ctx_free(dec);
+    set_free(&t);
+}
+
+/* Cut 'buf' into entries of random length */
+static struct scatterlist *sg_chop(uint8_t *buf, size_t len)
+{
+    struct scatterlist *sg = calloc(len + 1, sizeof(*sg));
+    size_t n = 0, pos, l;
+
+    for (pos = 0; pos < len; pos += l) {
+        l = 1 + rand() % 9000;
+        if (l > len - pos)
+            l = len - pos;
+        sg_set_buf(&sg[n++], buf + pos, l);
+    }
+    sg[n - 1].end = true;
+    return sg;
+}
+
+static void test_sg(void)
+{
+    struct scatterlist *shares[MAX_SHARES], *use[MAX_SHARES], *sec, *out;
+    struct test_set t;
+    gfshare_ctx *enc, *dec;
+    size_t c;
+    uint32_t i;
+
+    for (c = 0; c < sizeof(test_configs) / sizeof(test_configs[0]); c++) {
+        set_init(&t, 50000, test_configs[c].threshold, test_configs[c].sharecount);
+        for (i = 0; i < t.sharecount; i++)
+            shares[i] = sg_chop(t.shares[i], t.size);
+        sec = sg_chop(t.secret, t.size);
+        out = sg_chop(t.out, t.size);
+        enc = gfshare_ctx_init_enc(t.sharenrs, t.sharecount, t.threshold, t.size);
+        dec = gfshare_ctx_init_dec(t.sharenrs, t.sharecount, t.threshold, t.size);
+        CHECK(enc && dec, "init");
+        CHECK(!gfshare_ctx_enc_getshares_sg(enc, sec, shares), "split");
+        gfshare_ctx_dec_newshares(dec, t.present);
+        for (i = 0; i < t.sharecount; i++)
+            use[i] = t.present[i] ? shares[i] : NULL;
+        CHECK(!gfshare_ctx_dec_extract_sg(dec, use, out), "combine");
+        CHECK(!memcmp(t.out, t.secret, t.size), "mismatch %u/%u", t.threshold,
+              t.sharecount);
+        gfshare_ctx_free(enc);
+        gfshare_ctx_free(dec);
+        for (i = 0; i < t.sharecount; i++)
+            free(shares[i]);
+        free(sec);
+        free(out);
+        set_free(&t);
+    }
+}
+
+/* ----------------------------------------------[ ramp and hybrid ]---- */
+
+enum test_kind { KIND_PLAIN, KIND_RAMP, KIND_HYBRID };
+
+static const char *const kind_names[] = { "plain", "ramp", "hybrid" };
+
+static gfshare_ctx *kind_init(enum test_kind kind, int dec,
+                              const struct test_set *t)
+{
+    switch (kind) {
+    case KIND_RAMP:
+        return (dec ? gfshare_ctx_init_dec_ramp : gfshare_ctx_init_enc_ramp)(
+            t->sharenrs, t->sharecount, t->threshold, 1, t->size);
+    case KIND_HYBRID:
+        return (dec ? gfshare_ctx_init_dec_hybrid : gfshare_ctx_init_enc_hybrid)(
+            t->sharenrs, t->sharecount, t->threshold, t->size);
+    default:
+        return (dec ? gfshare_ctx_init_dec : gfshare_ctx_init_enc)(
+            t->sharenrs, t->sharecount, t->threshold, t->size);
+    }
+}
+
+static void test_ramp_hybrid(void)
+{
+    struct test_set t;
+    gfshare_ctx *enc, *dec;
+    enum test_kind kind;
+    size_t s;
+
+    for (kind = KIND_RAMP; kind <= KIND_HYBRID; kind++) {
+        for (s = 0; s < sizeof(test_sizes) / sizeof(test_sizes[0]); s++) {
+            set_init(&t, test_sizes[s], 4, 7);
+            enc = kind_init(kind, 0, &t);
+            dec = kind_init(kind, 1, &t);
+            CHECK(enc && dec, "init %s", kind_names[kind]);
+            CHECK(t.size < 64 || gfshare_ctx_sharesize(enc) < t.size,
+                  "%s shares of a %zu byte secret are %zu bytes", kind_names[kind],
+                  t.size, gfshare_ctx_sharesize(enc));
+            gfshare_ctx_enc_getshares(enc, t.secret, t.shares);
+            set_combine(&t, dec);
+            CHECK(!memcmp(t.out, t.secret, t.size), "%s size %zu", kind_names[kind],
+                  t.size);
+            gfshare_ctx_free(enc);
+            gfshare_ctx_free(dec);
+            set_free(&t);
+        }
+    }
+}
+
+/* Random windows of the secret, compared with the whole */
+static void test_range(void)
+{
+    struct test_set t;
+    gfshare_ctx *enc, *dec;
+    enum test_kind kind;
+    size_t off, len;
+    uint8_t *win;
+    int round;
+
+    for (kind = KIND_PLAIN; kind <= KIND_HYBRID; kind++) {
+        set_init(&t, 70000, 3, 5);
+        enc = kind_init(kind, 0, &t);
+        dec = kind_init(kind, 1, &t);
+        CHECK(enc && dec, "init %s", kind_names[kind]);
+        gfshare_ctx_enc_getshares(enc, t.secret, t.shares);
+        set_combine(&t, dec);
+        win = malloc(t.size);
+        for (round = 0; round < 50; round++) {
+            off = rand() % t.size;
+            len = rand() % (t.size - off + 1);
+            CHECK(!gfshare_ctx_dec_extract_range(dec, off, len, win), "range");
+            CHECK(!memcmp(win, t.secret + off, len), "%s [%zu, +%zu)",
+                  kind_names[kind], off, len);
+        }
+        CHECK(gfshare_ctx_dec_extract_range(dec, t.size, 1, win),
+              "range past the end accepted");
+        free(win);
+        gfshare_ctx_free(enc);
+        gfshare_ctx_free(dec);
+        set_free(&t);
+    }
+}
+
+/* A share rebuilt from 'threshold' others is the one the encoder made */
+static void test_repair(void)
+{
+    struct test_set t;
+    gfshare_ctx *enc, *dec;
+    enum test_kind kind;
+    uint8_t *rebuilt;
+    uint32_t lost;
+    size_t len;
+
+    for (kind = KIND_PLAIN; kind <= KIND_HYBRID; kind++) {
+        set_init(&t, 4099, 3, 6);
+        enc = kind_init(kind, 0, &t);
+        dec = kind_init(kind, 1, &t);
+        CHECK(enc && dec, "init %s", kind_names[kind]);
+        gfshare_ctx_enc_getshares(enc, t.secret, t.shares);
+        len = gfshare_ctx_sharesize(enc);
+        rebuilt = malloc(len);
+        for (lost = 0; lost < t.sharecount; lost++) {
+            if (t.present[lost])
+                continue;
+            set_combine(&t, dec);
+            CHECK(!gfshare_ctx_repair_share(dec, t.sharenrs[lost], rebuilt), "repair");
+            CHECK(!memcmp(rebuilt, t.shares[lost], len), "%s share %u",
+                  kind_names[kind], lost);
+        }
+        free(rebuilt);
+        gfshare_ctx_free(enc);
+        gfshare_ctx_free(dec);
+        set_free(&t);
+    }
+}
+
+/* Refreshed shares all change and still give the secret, from any set */
+static void test_refresh(void)
+{
+    uint8_t *before[MAX_SHARES];
+    struct test_set t;
+    gfshare_ctx *enc, *dec;
+    enum test_kind kind;
+    size_t len;
+    uint32_t i;
+
+    for (kind = KIND_PLAIN; kind <= KIND_HYBRID; kind++) {
+        set_init(&t, 4099, 3, 6);
+        enc = kind_init(kind, 0, &t);
+        dec = kind_init(kind, 1, &t);
+        CHECK(enc && dec, "init %s", kind_names[kind]);
+        gfshare_ctx_enc_getshares(enc, t.secret, t.shares);
+        len = gfshare_ctx_sharesize(enc);
+        for (i = 0; i < t.sharecount; i++) {
+            before[i] = malloc(len);
+            memcpy(before[i], t.shares[i], len);
+        }
+        CHECK(!gfshare_ctx_enc_refresh(enc, t.shares), "refresh");
+        for (i = 0; i < t.sharecount; i++) {
+            CHECK(memcmp(before[i], t.shares[i], len), "%s share %u unchanged",
+                  kind_names[kind], i);
+            free(before[i]);
+        }
+        set_combine(&t, dec);
+        CHECK(!memcmp(t.out, t.secret, t.size), "%s after refresh", kind_names[kind]);
+        gfshare_ctx_free(enc);
+        gfshare_ctx_free(dec);
+        set_free(&t);
+    }
+}
+
+/* Two of seven shares damaged, one in a single byte and one throughout */
+static void test_correct(void)
+{
+    uint8_t bad[MAX_SHARES];
+    struct test_set t;
+    gfshare_ctx *enc, *dec;
+    enum test_kind kind;
+    size_t len, p;
+    uint32_t i;
+
+    for (kind = KIND_PLAIN; kind <= KIND_HYBRID; kind++) {
+        set_init(&t, 4099, 3, 7);
+        enc = kind_init(kind, 0, &t);
+        dec = kind_init(kind, 1, &t);
+        CHECK(enc && dec, "init %s", kind_names[kind]);
+        gfshare_ctx_enc_getshares(enc, t.secret, t.shares);
+        len = gfshare_ctx_sharesize(enc);
+        t.shares[2][len / 2] ^= 0x5a;
+        for (p = 0; p < len; p++)
+            t.shares[5][p] ^= rand() | 1;
+        for (i = 0; i < t.sharecount; i++)
+            gfshare_ctx_dec_giveshare(dec, i, t.shares[i]);
+        CHECK(!gfshare_ctx_dec_extract_correct(dec, t.out, bad), "%s correct",
+              kind_names[kind]);
+        CHECK(!memcmp(t.out, t.secret, t.size), "%s secret", kind_names[kind]);
+        for (i = 0; i < t.sharecount; i++)
+            CHECK(bad[i] == (i == 2 || i == 5), "%s share %u flagged %u",
+                  kind_names[kind], i, bad[i]);
+        gfshare_ctx_free(enc);
+        gfshare_ctx_free(dec);
+        set_free(&t);
+    }
+}
+
+/* --------------------------------------------------------[ GF(2^16) ]---- */
+
+static void test_gf16(void)
+{
+    static const size_t sizes[] = { 1, 2, 63, 64, 65, 4099, 70000 };
+    uint16_t sharenrs[300], present[300];
+    uint8_t *shares[300], *secret, *out;
+    gfshare16_ctx *enc, *dec;
+    uint32_t i, have;
+    size_t s, size;
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size = sizes[s];
+        for (i = 0; i < 300; i++)
+            sharenrs[i] = i * 211 + 1;
+        memcpy(present, sharenrs, sizeof(present));
+        for (have = 300; have > 10; ) {
+            i = rand() % 300;
+            if (present[i]) {
+                present[i] = 0;
+                have--;
+            }
+        }
+        secret = malloc(size);
+        out = malloc(size);
+        fill_random(secret, size);
+        for (i = 0; i < 300; i++)
+            shares[i] = malloc(size + 1);
+        enc = gfshare16_ctx_init_enc(sharenrs, 300, 10, size);
+        dec = gfshare16_ctx_init_dec(sharenrs, 300, 10, size);
+        CHECK(enc && dec, "init");
+        CHECK(!gfshare16_ctx_enc_getshares(enc, secret, shares), "split");
+        gfshare16_ctx_dec_newshares(dec, present);
+        for (i = 0; i < 300; i++) {
+            if (present[i])
+                gfshare16_ctx_dec_giveshare(dec, i, shares[i]);
+        }
+        gfshare16_ctx_dec_extract(dec, out);
+        CHECK(!memcmp(out, secret, size), "size %zu", size);
+        CHECK(gfshare16_ctx_setsize(enc, size), "setsize(maxsize) accepted");
+        gfshare16_ctx_free(enc);
+        gfshare16_ctx_free(dec);
+        for (i = 0; i < 300; i++)
+            free(shares[i]);
+        free(secret);
+        free(out);
+    }
+}
+
+/* -----------------------------------------------------------[ Async ]---- */
+
+struct async_item {
+    struct test_set t;
+    struct gfshare_job split, combine;
+    uint8_t *given[MAX_SHARES];
+    gfshare_ctx *enc, *dec;
+    int err;
+};
+
+static pthread_mutex_t async_lock = PTHREAD_MUTEX_INITIALIZER;
+static int async_done;
+
+static void async_combined(struct gfshare_job *job, int err)
+{
+    struct async_item *a = job->priv;
+
+    pthread_mutex_lock(&async_lock);
+    a->err = err ? err : memcmp(a->t.out, a->t.secret, a->t.size) != 0;
+    async_done++;
+    pthread_mutex_unlock(&async_lock);
+}
+
+/* Recombine from the completion of the split */
+static void async_split(struct gfshare_job *job, int err)
+{
+    struct async_item *a = job->priv;
+    uint32_t i;
+
+    for (i = 0; i < a->t.sharecount; i++)
+        a->given[i] = a->t.present[i] ? a->t.shares[i] : NULL;
+    gfshare_ctx_dec_newshares(a->dec, a->t.present);
+    a->combine = (struct gfshare_job){
+        .op = GFSHARE_JOB_COMBINE, .ctx = a->dec, .shares = a->given,
+        .secretbuf = a->t.out, .done = async_combined, .priv = a,
+    };
+    if (err || gfshare_job_submit(&a->combine))
+        async_combined(&a->combine, -EIO);
+}
+
+static void test_async(void)
+{
+    enum { COUNT = 64 };
+    static struct async_item items[COUNT];
+    struct async_item *a;
+    int j, r, waited, done;
+
+    async_done = 0;
+    for (j = 0; j < COUNT; j++) {
+        a = &items[j];
+        set_init(&a->t, 1 + rand() % 20000, 3, 5);
+        a->enc = gfshare_ctx_init_enc(a->t.sharenrs, 5, 3, a->t.size);
+        a->dec = gfshare_ctx_init_dec(a->t.sharenrs, 5, 3, a->t.size);
+        CHECK(a->enc && a->dec, "init");
+        a->split = (struct gfshare_job){
+            .op = GFSHARE_JOB_SPLIT, .ctx = a->enc, .secret = a->t.secret,
+            .shares = a->t.shares, .done = async_split, .priv = a,
+        };
+        while ((r = gfshare_job_submit(&a->split)) == -EBUSY)
+            usleep(100);
+        CHECK(r == 0, "submit %d", r);
+    }
+    for (waited = 0; waited < 10000; waited++) {
+        pthread_mutex_lock(&async_lock);
+        done = async_done;
+        pthread_mutex_unlock(&async_lock);
+        if (done == COUNT)
+            break;
+        usleep(1000);
+    }
+    CHECK(done == COUNT, "%d of %d jobs completed", done, COUNT);
+    for (j = 0; j < COUNT; j++) {
+        a = &items[j];
+        CHECK(!a->err, "job %d: %d", j, a->err);
+        gfshare_ctx_free(a->enc);
+        gfshare_ctx_free(a->dec);
+        set_free(&a->t);
+    }
+}
+
+/* ----------------------------------------------------------[ Misuse ]---- */
+
+/* Calls made on the wrong kind of context are refused, not carried out */
+static void test_misuse(void)
+{
+    uint8_t **batch[1], *secrets[1];
+    struct scatterlist sec, *shares[MAX_SHARES];
+    struct test_set t;
+    gfshare_ctx *enc, *dec, *borrowed;
+    uint32_t i;
+
+    set_init(&t, 1000, 3, 5);
+    enc = gfshare_ctx_init_enc(t.sharenrs, 5, 3, t.size);
+    dec = gfshare_ctx_init_dec(t.sharenrs, 5, 3, t.size);
+    borrowed = gfshare_ctx_init_dec_borrowed(t.sharenrs, 5, 3, t.size);
+    CHECK(enc && dec && borrowed, "init");
+
+    CHECK(gfshare_ctx_enc_stream_init(dec), "stream on a decoder");
+    CHECK(gfshare_ctx_enc_stream_init(borrowed), "stream on a borrowed decoder");
+    CHECK(gfshare_ctx_enc_stream_update(borrowed, t.secret, t.size, t.shares),
+          "stream update on a borrowed decoder");
+    CHECK(gfshare_ctx_enc_refresh(dec, t.shares), "refresh on a decoder");
+    CHECK(gfshare_ctx_enc_refresh(borrowed, t.shares),
+          "refresh on a borrowed decoder");
+
+    batch[0] = t.shares;
+    secrets[0] = t.out;
+    CHECK(gfshare_ctx_dec_extract_batch(enc, 1, batch, secrets),
+          "batch extract on an encoder");
+    sg_init_one(&sec, t.out, t.size);
+    for (i = 0; i < t.sharecount; i++)
+        shares[i] = &sec;
+    CHECK(gfshare_ctx_dec_extract_sg(enc, shares, &sec), "sg extract on an encoder");
+    CHECK(gfshare_ctx_dec_extract_range(enc, 0, 1, t.out),
+          "range extract on an encoder");
+    CHECK(gfshare_ctx_repair_share(enc, 1, t.out), "repair on an encoder");
+    CHECK(gfshare_ctx_setsize(enc, t.size), "setsize(maxsize) accepted");
+    CHECK(gfshare_ctx_setsize(enc, 0), "setsize(0) accepted");
+
+    gfshare_ctx_free(enc);
+    gfshare_ctx_free(dec);
+    gfshare_ctx_free(borrowed);
+    set_free(&t);
+}
+
+static const struct {
+    const char *name;
+    void (*fn)(void);
+} tests[] = {
+    { "plain", test_plain },
+    { "engines", test_engines },
+    { "borrowed", test_borrowed },
+    { "pooled", test_pooled },
+    { "batch", test_batch },
+    { "stream", test_stream },
+    { "sg", test_sg },
+    { "ramp_hybrid", test_ramp_hybrid },
+    { "range", test_range },
+    { "repair", test_repair },
+    { "refresh", test_refresh },
+    { "correct", test_correct },
+    { "gf16", test_gf16 },
+    { "async", test_async },
+    { "misuse", test_misuse },
+};
+
+int main(int argc, char **argv)
+{
+    size_t i;
+    int before, ran = 0;
+
+    if (gfshare_init()) {
+        fprintf(stderr, "gfshare_test: gfshare_init failed\n");
+        return 1;
+    }
+    srand(1);
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        if (argc > 1 && strcmp(argv[1], tests[i].name))
+            continue;
+        before = failures;
+        tests[i].fn();
+        printf("%-12s %s\n", tests[i].name, failures == before ? "ok" : "FAILED");
+        ran++;
+    }
+    gfshare_exit();
+    if (ran == 0) {
+        fprintf(stderr, "gfshare_test: no test '%s'\n", argv[1]);
+        return 1;
+    }
+    return failures != 0;
+}
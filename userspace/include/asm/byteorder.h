@@ -0,0 +1,21 @@
+#ifndef GFSHARE_SHIM_ASM_BYTEORDER_H
+#define GFSHARE_SHIM_ASM_BYTEORDER_H
+
+#include <endian.h>
+#include <linux/types.h>
+
+typedef uint16_t __le16;
+typedef uint32_t __le32;
+typedef uint64_t __le64;
+typedef uint32_t __be32;
+typedef uint64_t __be64;
+
+#define cpu_to_le16(x) htole16(x)
+#define cpu_to_le32(x) htole32(x)
+#define cpu_to_le64(x) htole64(x)
+#define le16_to_cpu(x) le16toh(x)
+#define le32_to_cpu(x) le32toh(x)
+#define le64_to_cpu(x) le64toh(x)
+#define cpu_to_be64(x) htobe64(x)
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef GFSHARE_SHIM_ASM_CPUFEATURE_H
+#define GFSHARE_SHIM_ASM_CPUFEATURE_H
+
+#define X86_FEATURE_SSSE3 "ssse3"
+#define X86_FEATURE_AVX "avx"
+#define X86_FEATURE_AVX2 "avx2"
+
+#define boot_cpu_has(feature) __builtin_cpu_supports(feature)
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef GFSHARE_SHIM_ASM_FPU_API_H
+#define GFSHARE_SHIM_ASM_FPU_API_H
+
+/* Userspace always owns its vector registers. The library objects are
+ * built with -mgeneral-regs-only, as the kernel builds them, so the
+ * compiler never has live values in them across the asm blocks.
+ */
+#define XFEATURE_MASK_SSE 2
+#define XFEATURE_MASK_YMM 4
+
+static inline int cpu_has_xfeatures(unsigned long mask, const char **name)
+{
+    return 1;
+}
+
+static inline void kernel_fpu_begin(void) { }
+static inline void kernel_fpu_end(void) { }
+
+#endif
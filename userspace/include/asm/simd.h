@@ -0,0 +1,6 @@
+#ifndef GFSHARE_SHIM_ASM_SIMD_H
+#define GFSHARE_SHIM_ASM_SIMD_H
+
+#define may_use_simd() 1
+
+#endif
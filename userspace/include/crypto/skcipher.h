@@ -0,0 +1,41 @@
+#ifndef GFSHARE_SHIM_CRYPTO_SKCIPHER_H
+#define GFSHARE_SHIM_CRYPTO_SKCIPHER_H
+
+/* There is no crypto API in userspace: every algorithm is reported missing,
+ * so only the Speck random backend is available.
+ */
+#include <errno.h>
+#include <linux/err.h>
+#include <linux/scatterlist.h>
+
+struct crypto_sync_skcipher;
+struct skcipher_request { int unused; };
+
+#define SYNC_SKCIPHER_REQUEST_ON_STACK(name, tfm) \
+    struct skcipher_request __##name##_desc, *name = &__##name##_desc
+
+static inline struct crypto_sync_skcipher *
+crypto_alloc_sync_skcipher(const char *alg, unsigned int type, unsigned int mask)
+{
+    return ERR_PTR(-ENOENT);
+}
+
+static inline void crypto_free_sync_skcipher(struct crypto_sync_skcipher *tfm) { }
+
+static inline int crypto_sync_skcipher_setkey(struct crypto_sync_skcipher *tfm,
+                                              const uint8_t *key, unsigned int len)
+{
+    return -ENOENT;
+}
+
+static inline void skcipher_request_set_sync_tfm(struct skcipher_request *req,
+                                                 struct crypto_sync_skcipher *tfm) { }
+static inline void skcipher_request_set_callback(struct skcipher_request *req,
+                                                 unsigned int flags, void *fn, void *data) { }
+static inline void skcipher_request_set_crypt(struct skcipher_request *req,
+                                              struct scatterlist *src, struct scatterlist *dst,
+                                              unsigned int len, void *iv) { }
+static inline int crypto_skcipher_encrypt(struct skcipher_request *req) { return -ENOENT; }
+static inline void skcipher_request_zero(struct skcipher_request *req) { }
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef GFSHARE_SHIM_LINUX_BITOPS_H
+#define GFSHARE_SHIM_LINUX_BITOPS_H
+
+#include <linux/types.h>
+
+static inline int fls64(uint64_t x)
+{
+    return x ? 64 - __builtin_clzll(x) : 0;
+}
+
+#define BITS_PER_LONG (8 * (int)sizeof(long))
+#define BITS_TO_LONGS(n) (((n) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+
+static inline int __test_and_set_bit(unsigned long nr, unsigned long *addr)
+{
+    unsigned long *p = addr + nr / BITS_PER_LONG;
+    unsigned long mask = 1UL << (nr % BITS_PER_LONG);
+    int old = (*p & mask) != 0;
+
+    *p |= mask;
+    return old;
+}
+
+#endif
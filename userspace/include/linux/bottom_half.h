@@ -0,0 +1,8 @@
+#ifndef GFSHARE_SHIM_LINUX_BOTTOM_HALF_H
+#define GFSHARE_SHIM_LINUX_BOTTOM_HALF_H
+
+/* No softirqs to hold off */
+#define local_bh_disable() do { } while (0)
+#define local_bh_enable() do { } while (0)
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef GFSHARE_SHIM_LINUX_BUILD_BUG_H
+#define GFSHARE_SHIM_LINUX_BUILD_BUG_H
+
+#define BUILD_BUG_ON(cond) _Static_assert(!(cond), "BUILD_BUG_ON(" #cond ")")
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef GFSHARE_SHIM_LINUX_CPUMASK_H
+#define GFSHARE_SHIM_LINUX_CPUMASK_H
+
+#include <unistd.h>
+#include <linux/percpu.h>
+
+#define num_online_cpus() ((unsigned int)sysconf(_SC_NPROCESSORS_ONLN))
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef GFSHARE_SHIM_LINUX_DEBUGFS_H
+#define GFSHARE_SHIM_LINUX_DEBUGFS_H
+
+/* There is no debugfs: files are never created */
+#include <linux/fs.h>
+#include <linux/types.h>
+
+struct dentry;
+
+static inline struct dentry *debugfs_create_dir(const char *name, struct dentry *parent)
+{
+    return NULL;
+}
+
+static inline struct dentry *debugfs_create_file(const char *name, unsigned short mode,
+                                                 struct dentry *parent, void *data,
+                                                 const struct file_operations *fops)
+{
+    return NULL;
+}
+
+#define debugfs_create_file_unsafe debugfs_create_file
+
+static inline void debugfs_remove_recursive(struct dentry *dentry) { }
+
+#define DEFINE_DEBUGFS_ATTRIBUTE(__fops, __get, __set, __fmt)           \
+    static const struct file_operations __fops = {                     \
+        .owner = THIS_MODULE,                                           \
+    };                                                                  \
+    static inline int __fops##_unused(void)                             \
+    {                                                                   \
+        return (__get) == NULL || (__set) == NULL;                      \
+    }
+
+#endif
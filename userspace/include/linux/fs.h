@@ -0,0 +1,28 @@
+#ifndef GFSHARE_SHIM_LINUX_FS_H
+#define GFSHARE_SHIM_LINUX_FS_H
+
+#include <linux/types.h>
+
+#define __user
+
+struct module;
+struct inode;
+struct file {
+    void *private_data;
+};
+
+struct file_operations {
+    struct module *owner;
+    int (*open)(struct inode *inode, struct file *file);
+    int (*release)(struct inode *inode, struct file *file);
+    ssize_t (*read)(struct file *file, char __user *buf, size_t count, loff_t *ppos);
+    ssize_t (*write)(struct file *file, const char __user *buf, size_t count, loff_t *ppos);
+    loff_t (*llseek)(struct file *file, loff_t offset, int whence);
+};
+
+static inline loff_t noop_llseek(struct file *file, loff_t offset, int whence)
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef GFSHARE_SHIM_LINUX_HIGHMEM_H
+#define GFSHARE_SHIM_LINUX_HIGHMEM_H
+
+#include <linux/mm.h>
+
+#define kmap_local_page(pg) ((void *)page_address(pg))
+#define kunmap_local(addr) ((void)(addr))
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef GFSHARE_SHIM_LINUX_IRQFLAGS_H
+#define GFSHARE_SHIM_LINUX_IRQFLAGS_H
+
+#define irqs_disabled() 0
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef GFSHARE_SHIM_LINUX_JUMP_LABEL_H
+#define GFSHARE_SHIM_LINUX_JUMP_LABEL_H
+
+#include <linux/atomic.h>
+
+/* No code patching: a static key is a counter tested on every use */
+struct static_key_false {
+    atomic_t enabled;
+};
+
+#define DEFINE_STATIC_KEY_FALSE(name) struct static_key_false name = { ATOMIC_INIT(0) }
+#define DECLARE_STATIC_KEY_FALSE(name) extern struct static_key_false name
+
+#define static_branch_unlikely(key) __builtin_expect(atomic_read(&(key)->enabled) > 0, 0)
+#define static_branch_likely(key) __builtin_expect(atomic_read(&(key)->enabled) > 0, 1)
+#define static_branch_inc(key) atomic_inc(&(key)->enabled)
+#define static_branch_dec(key) atomic_dec(&(key)->enabled)
+
+#endif
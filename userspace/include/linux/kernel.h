@@ -0,0 +1,33 @@
+#ifndef GFSHARE_SHIM_LINUX_KERNEL_H
+#define GFSHARE_SHIM_LINUX_KERNEL_H
+
+#include <errno.h>
+#include <linux/types.h>
+
+#define KERN_SOH "\001"
+#define KERN_ERR KERN_SOH "3"
+#define KERN_WARNING KERN_SOH "4"
+#define KERN_INFO KERN_SOH "6"
+#define KERN_DEBUG KERN_SOH "7"
+
+/* Prints to stderr when the message level is at or below $GFSHARE_LOGLEVEL
+ * (default 4, warnings).
+ */
+int printk(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define min_t(t, a, b) ((t)(a) < (t)(b) ? (t)(a) : (t)(b))
+#define max_t(t, a, b) ((t)(a) > (t)(b) ? (t)(a) : (t)(b))
+#define clamp_t(t, v, lo, hi) min_t(t, max_t(t, v, lo), hi)
+#define ALIGN(x, a) (((x) + (a) - 1) & ~((size_t)(a) - 1))
+#define DIV_ROUND_UP(n, d) (((n) + (d) - 1) / (d))
+#define container_of(p, t, m) ((t *)((char *)(p) - offsetof(t, m)))
+/* There is no Kconfig; every option tested this way is off */
+#define IS_ENABLED(option) 0
+#define might_sleep() do { } while (0)
+#define READ_ONCE(x) (*(const volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, v) (*(volatile __typeof__(x) *)&(x) = (v))
+
+#endif
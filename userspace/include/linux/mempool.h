@@ -0,0 +1,35 @@
+#ifndef GFSHARE_SHIM_LINUX_MEMPOOL_H
+#define GFSHARE_SHIM_LINUX_MEMPOOL_H
+
+/* malloc doesn't fail in the benchmark, so there is no reserve to keep */
+#include <linux/slab.h>
+
+typedef struct mempool {
+    struct kmem_cache *cache;
+} mempool_t;
+
+static inline mempool_t *mempool_create_slab_pool(int min_nr, struct kmem_cache *cache)
+{
+    mempool_t *pool = malloc(sizeof(*pool));
+
+    if (pool)
+        pool->cache = cache;
+    return pool;
+}
+
+static inline void mempool_destroy(mempool_t *pool)
+{
+    free(pool);
+}
+
+static inline void *mempool_alloc(mempool_t *pool, gfp_t gfp)
+{
+    return kmem_cache_alloc(pool->cache, gfp);
+}
+
+static inline void mempool_free(void *p, mempool_t *pool)
+{
+    kmem_cache_free(pool->cache, p);
+}
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef GFSHARE_SHIM_LINUX_MM_H
+#define GFSHARE_SHIM_LINUX_MM_H
+
+#include <stdint.h>
+
+/* A struct page pointer is the address of the page it stands for */
+struct page;
+
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1UL << PAGE_SHIFT)
+#define PAGE_MASK (~(PAGE_SIZE - 1))
+
+#define offset_in_page(p) ((unsigned long)(p) & ~PAGE_MASK)
+#define virt_to_page(p) ((struct page *)((uintptr_t)(p) & PAGE_MASK))
+#define page_address(pg) ((uint8_t *)(pg))
+#define nth_page(pg, n) ((struct page *)((uint8_t *)(pg) + ((n) << PAGE_SHIFT)))
+
+/* Everything is "linearly mapped" in userspace */
+#define virt_addr_valid(p) ((p) != NULL)
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef GFSHARE_SHIM_LINUX_MODULE_H
+#define GFSHARE_SHIM_LINUX_MODULE_H
+
+/* Module parameters keep their compiled-in defaults */
+#define module_param(name, type, perm)
+#define MODULE_PARM_DESC(name, desc)
+#define MODULE_LICENSE(x)
+#define MODULE_AUTHOR(x)
+#define THIS_MODULE ((struct module *)0)
+#define EXPORT_SYMBOL(x)
+#define EXPORT_SYMBOL_GPL(x)
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef GFSHARE_SHIM_LINUX_PERCPU_H
+#define GFSHARE_SHIM_LINUX_PERCPU_H
+
+#include <stdlib.h>
+
+/* One "CPU": per-CPU variables are plain globals. */
+#define DEFINE_PER_CPU(type, name) __typeof__(type) name
+#define this_cpu_ptr(p) (p)
+#define raw_cpu_ptr(p) (p)
+#define per_cpu_ptr(p, cpu) ((void)(cpu), (p))
+#define get_cpu_ptr(p) (p)
+#define put_cpu_ptr(p) do { } while (0)
+#define __percpu
+#define alloc_percpu(type) ((type *)calloc(1, sizeof(type)))
+#define free_percpu(p) free(p)
+#define for_each_possible_cpu(cpu) for ((cpu) = 0; (cpu) < 1; (cpu)++)
+#define for_each_online_cpu(cpu) for_each_possible_cpu(cpu)
+#define smp_processor_id() 0
+
+/* Work items run on other threads, so these must still be atomic */
+#define this_cpu_add(var, val) ((void)__atomic_add_fetch(&(var), (val), __ATOMIC_RELAXED))
+#define this_cpu_inc(var) this_cpu_add(var, 1)
+
+#endif
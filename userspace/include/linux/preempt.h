@@ -0,0 +1,9 @@
+#ifndef GFSHARE_SHIM_LINUX_PREEMPT_H
+#define GFSHARE_SHIM_LINUX_PREEMPT_H
+
+#define in_task() 1
+#define in_interrupt() 0
+#define in_hardirq() 0
+#define preemptible() 1
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef GFSHARE_SHIM_LINUX_RANDOM_H
+#define GFSHARE_SHIM_LINUX_RANDOM_H
+
+#include <sys/random.h>
+#include <linux/types.h>
+
+static inline void get_random_bytes(void *buf, size_t n)
+{
+    uint8_t *p = buf;
+    ssize_t got;
+
+    while (n) {
+        got = getrandom(p, n, 0);
+        if (got <= 0)
+            continue;
+        p += got;
+        n -= got;
+    }
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef GFSHARE_SHIM_LINUX_SCATTERLIST_H
+#define GFSHARE_SHIM_LINUX_SCATTERLIST_H
+
+#include <linux/mm.h>
+#include <linux/string.h>
+#include <linux/types.h>
+
+struct scatterlist {
+    struct page *page;
+    unsigned int offset;
+    unsigned int length;
+    bool end;
+};
+
+static inline struct page *sg_page(struct scatterlist *sg)
+{
+    return sg->page;
+}
+
+static inline void sg_set_buf(struct scatterlist *sg, const void *buf, unsigned int len)
+{
+    sg->page = virt_to_page(buf);
+    sg->offset = offset_in_page(buf);
+    sg->length = len;
+}
+
+static inline void sg_init_table(struct scatterlist *sgl, unsigned int nents)
+{
+    memset(sgl, 0, sizeof(*sgl) * nents);
+    sgl[nents - 1].end = true;
+}
+
+static inline void sg_init_one(struct scatterlist *sg, const void *buf, unsigned int len)
+{
+    sg_init_table(sg, 1);
+    sg_set_buf(sg, buf, len);
+}
+
+static inline struct scatterlist *sg_next(struct scatterlist *sg)
+{
+    return sg->end ? NULL : sg + 1;
+}
+
+static inline void *sg_virt(struct scatterlist *sg)
+{
+    return page_address(sg->page) + sg->offset;
+}
+
+#endif
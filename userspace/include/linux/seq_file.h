@@ -0,0 +1,24 @@
+#ifndef GFSHARE_SHIM_LINUX_SEQ_FILE_H
+#define GFSHARE_SHIM_LINUX_SEQ_FILE_H
+
+#include <stdio.h>
+#include <linux/fs.h>
+
+/* A seq_file just prints to stdout */
+struct seq_file {
+    void *private;
+};
+
+#define seq_printf(m, ...) ((void)(m), printf(__VA_ARGS__))
+#define seq_puts(m, s) ((void)(m), fputs((s), stdout))
+
+#define DEFINE_SHOW_ATTRIBUTE(__name)                                   \
+    static const struct file_operations __name##_fops = {              \
+        .owner = THIS_MODULE,                                           \
+    };                                                                  \
+    static inline int __name##_show_unused(void)                        \
+    {                                                                   \
+        return __name##_show == NULL;                                   \
+    }
+
+#endif
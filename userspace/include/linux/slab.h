@@ -0,0 +1,65 @@
+#ifndef GFSHARE_SHIM_LINUX_SLAB_H
+#define GFSHARE_SHIM_LINUX_SLAB_H
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+
+#define GFP_KERNEL 0u
+#define GFP_ATOMIC 1u
+#define GFP_NOWAIT 2u
+
+#define kmalloc(n, f) malloc(n)
+#define kzalloc(n, f) calloc(1, (n))
+#define kmalloc_array(n, s, f) malloc((size_t)(n) * (s))
+#define kcalloc(n, s, f) calloc((n), (s))
+#define kfree free
+#define kvmalloc_array(n, s, f) malloc((size_t)(n) * (s))
+#define kvfree free
+
+static inline void kfree_sensitive(void *p)
+{
+    if (p) {
+        memzero_explicit(p, malloc_usable_size(p));
+        free(p);
+    }
+}
+
+/* A cache just remembers its object size and alignment */
+#define SLAB_HWCACHE_ALIGN 1u
+
+struct kmem_cache {
+    size_t size;
+    size_t align;
+};
+
+static inline struct kmem_cache *kmem_cache_create(const char *name, unsigned int size,
+                                                   unsigned int align, unsigned int flags,
+                                                   void (*ctor)(void *))
+{
+    struct kmem_cache *c = malloc(sizeof(*c));
+
+    if (c) {
+        c->size = size;
+        c->align = align ? align : sizeof(void *);
+    }
+    return c;
+}
+
+static inline void kmem_cache_destroy(struct kmem_cache *c)
+{
+    free(c);
+}
+
+static inline void *kmem_cache_alloc(struct kmem_cache *c, gfp_t gfp)
+{
+    return aligned_alloc(c->align, ALIGN(c->size, c->align));
+}
+
+static inline void kmem_cache_free(struct kmem_cache *c, void *p)
+{
+    free(p);
+}
+
+#endif
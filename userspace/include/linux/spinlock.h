@@ -0,0 +1,15 @@
+#ifndef GFSHARE_SHIM_LINUX_SPINLOCK_H
+#define GFSHARE_SHIM_LINUX_SPINLOCK_H
+
+#include <pthread.h>
+
+typedef struct {
+    pthread_mutex_t m;
+} spinlock_t;
+
+#define DEFINE_SPINLOCK(name) spinlock_t name = { PTHREAD_MUTEX_INITIALIZER }
+#define spin_lock_init(l) pthread_mutex_init(&(l)->m, NULL)
+#define spin_lock_irqsave(l, flags) ((flags) = 0, pthread_mutex_lock(&(l)->m))
+#define spin_unlock_irqrestore(l, flags) ((void)(flags), pthread_mutex_unlock(&(l)->m))
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef GFSHARE_SHIM_LINUX_STRING_H
+#define GFSHARE_SHIM_LINUX_STRING_H
+
+#include <string.h>
+
+static inline void memzero_explicit(void *p, size_t n)
+{
+    memset(p, 0, n);
+    __asm__ volatile("" : : "r"(p) : "memory");
+}
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef GFSHARE_SHIM_LINUX_TIMEKEEPING_H
+#define GFSHARE_SHIM_LINUX_TIMEKEEPING_H
+
+#include <time.h>
+#include <linux/types.h>
+
+static inline uint64_t ktime_get_ns(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef GFSHARE_SHIM_LINUX_TRACEPOINT_H
+#define GFSHARE_SHIM_LINUX_TRACEPOINT_H
+
+/* Trace events compile to empty inlines, and are never enabled */
+#define PARAMS(args...) args
+#define TP_PROTO(args...) args
+#define TP_ARGS(args...) args
+#define TP_STRUCT__entry(args...)
+#define TP_fast_assign(args...)
+#define TP_printk(args...)
+
+#define DECLARE_EVENT_CLASS(name, proto, args, tstruct, assign, print)
+#define DEFINE_EVENT(template, name, proto, args)                       \
+    static inline void trace_##name(proto) { }                          \
+    static inline bool trace_##name##_enabled(void) { return false; }
+#define DEFINE_EVENT_FN(template, name, proto, args, reg, unreg)        \
+    DEFINE_EVENT(template, name, PARAMS(proto), PARAMS(args))
+#define TRACE_EVENT(name, proto, args, tstruct, assign, print)          \
+    DEFINE_EVENT(name, name, PARAMS(proto), PARAMS(args))
+#define TRACE_EVENT_FN(name, proto, args, tstruct, assign, print, reg, unreg) \
+    DEFINE_EVENT(name, name, PARAMS(proto), PARAMS(args))
+
+#endif
@@ -0,0 +1,22 @@
+/* Userspace stand-ins for the kernel headers libgfshare uses. */
+#ifndef GFSHARE_SHIM_LINUX_TYPES_H
+#define GFSHARE_SHIM_LINUX_TYPES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+typedef unsigned int gfp_t;
+
+#define __aligned(x) __attribute__((aligned(x)))
+#ifndef __always_inline
+#define __always_inline inline __attribute__((always_inline))
+#endif
+
+#endif
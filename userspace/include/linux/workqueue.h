@@ -0,0 +1,34 @@
+#ifndef GFSHARE_SHIM_LINUX_WORKQUEUE_H
+#define GFSHARE_SHIM_LINUX_WORKQUEUE_H
+
+#include <pthread.h>
+#include <linux/kernel.h>
+
+/* Every queued work item runs on its own thread. */
+struct work_struct;
+typedef void (*work_func_t)(struct work_struct *work);
+
+struct workqueue_struct;
+
+struct work_struct {
+    work_func_t func;
+    struct workqueue_struct *wq;    /* where it was last queued */
+    pthread_t thread;
+    bool started;
+};
+
+#define WQ_UNBOUND 1
+#define WQ_HIGHPRI 2
+#define WQ_MEM_RECLAIM 4
+
+#define INIT_WORK(w, f) ((w)->func = (f), (w)->wq = NULL, (w)->started = false)
+
+struct workqueue_struct *alloc_workqueue(const char *name, unsigned int flags, int max_active);
+void destroy_workqueue(struct workqueue_struct *wq);
+void flush_workqueue(struct workqueue_struct *wq);
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work);
+bool flush_work(struct work_struct *work);
+
+#define queue_work_on(cpu, wq, work) queue_work((wq), (work))
+
+#endif
@@ -0,0 +1 @@
+/* Nothing to instantiate without the tracing core */
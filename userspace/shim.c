@@ -0,0 +1,166 @@
+/*
+ * Out-of-line parts of the userspace kernel shims in userspace/include:
+ * printk and a thread-per-work workqueue. Only what libgfshare needs, and
+ * only as faithful as the benchmark needs.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+/* ----------------------------------------------------------[ printk ]---- */
+
+static int shim_loglevel = -1;
+
+int printk(const char *fmt, ...)
+{
+    const char *env;
+    va_list ap;
+    int level = 4, ret;
+
+    if (shim_loglevel < 0) {
+        env = getenv("GFSHARE_LOGLEVEL");
+        shim_loglevel = env ? atoi(env) : 4;
+    }
+    if (fmt[0] == KERN_SOH[0] && fmt[1] >= '0' && fmt[1] <= '7') {
+        level = fmt[1] - '0';
+        fmt += 2;
+    }
+    if (level > shim_loglevel)
+        return 0;
+
+    va_start(ap, fmt);
+    ret = vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    return ret;
+}
+
+/* -------------------------------------------------------[ workqueue ]---- */
+
+/* The queue only remembers the works it has started and nobody has joined
+ * yet, so that destroy_workqueue can wait for them. Whoever takes a work
+ * off that list joins its thread; after that the work may be freed.
+ */
+struct workqueue_struct {
+    pthread_mutex_t lock;
+    struct work_struct **works;
+    size_t nworks, cap;
+};
+
+static void *shim_work_thread(void *arg)
+{
+    struct work_struct *work = arg;
+
+    work->func(work);
+    return NULL;
+}
+
+struct workqueue_struct *alloc_workqueue(const char *name, unsigned int flags, int max_active)
+{
+    struct workqueue_struct *wq = kzalloc(sizeof(*wq), GFP_KERNEL);
+
+    if (wq)
+        pthread_mutex_init(&wq->lock, NULL);
+    return wq;
+}
+
+/* Unlist a started work; false if it wasn't listed. Called locked. */
+static bool shim_work_unlist(struct workqueue_struct *wq, struct work_struct *work)
+{
+    size_t i;
+
+    for (i = 0; i < wq->nworks; i++) {
+        if (wq->works[i] == work) {
+            wq->works[i] = wq->works[--wq->nworks];
+            work->started = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool shim_work_join(struct work_struct *work)
+{
+    struct workqueue_struct *wq = work->wq;
+    pthread_t thread;
+    bool listed;
+
+    if (!wq)
+        return false;
+    pthread_mutex_lock(&wq->lock);
+    thread = work->thread;
+    listed = shim_work_unlist(wq, work);
+    pthread_mutex_unlock(&wq->lock);
+    if (listed)
+        pthread_join(thread, NULL);
+    return listed;
+}
+
+/* A work is only requeued once its previous run has finished with it, so
+ * joining that run here never waits for long.
+ */
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work)
+{
+    struct work_struct **works;
+
+    shim_work_join(work);
+
+    pthread_mutex_lock(&wq->lock);
+    if (wq->nworks == wq->cap) {
+        works = realloc(wq->works, (wq->cap * 2 + 8) * sizeof(*works));
+        if (!works) {
+            pthread_mutex_unlock(&wq->lock);
+            work->func(work);
+            return true;
+        }
+        wq->works = works;
+        wq->cap = wq->cap * 2 + 8;
+    }
+    work->wq = wq;
+    if (pthread_create(&work->thread, NULL, shim_work_thread, work)) {
+        pthread_mutex_unlock(&wq->lock);
+        work->func(work);
+        return true;
+    }
+    work->started = true;
+    wq->works[wq->nworks++] = work;
+    pthread_mutex_unlock(&wq->lock);
+    return true;
+}
+
+bool flush_work(struct work_struct *work)
+{
+    return shim_work_join(work);
+}
+
+/* Works may queue more works while they are being waited for */
+void flush_workqueue(struct workqueue_struct *wq)
+{
+    struct work_struct *work;
+    pthread_t thread;
+
+    for (;;) {
+        pthread_mutex_lock(&wq->lock);
+        if (wq->nworks == 0) {
+            pthread_mutex_unlock(&wq->lock);
+            return;
+        }
+        work = wq->works[wq->nworks - 1];
+        thread = work->thread;
+        shim_work_unlist(wq, work);
+        pthread_mutex_unlock(&wq->lock);
+        pthread_join(thread, NULL);
+    }
+}
+
+void destroy_workqueue(struct workqueue_struct *wq)
+{
+    flush_workqueue(wq);
+    pthread_mutex_destroy(&wq->lock);
+    free(wq->works);
+    kfree(wq);
+}